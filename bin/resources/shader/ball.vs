@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// per instance
+layout (location = 2) in vec4 aCenterRadius;
+layout (location = 3) in vec3 aColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    // a unit sphere scaled uniformly and translated, so the normal needs no inverse transpose
+    FragPos = aCenterRadius.xyz + aPos * aCenterRadius.w;
+    Normal = aNormal;
+    Color = aColor;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+// one camera-facing quad per ball, the sphere is ray-cast in impostor.fs
+layout (location = 0) in vec2 aCorner; // -1 or 1 on each axis
+// per instance
+layout (location = 2) in vec4 aCenterRadius;
+layout (location = 3) in vec3 aColor;
+
+out vec3 FragPos;
+flat out vec3 Center;
+flat out float Radius;
+flat out vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    vec3 center = vec3(view * vec4(aCenterRadius.xyz, 1.0));
+    float radius = aCenterRadius.w;
+    Center = aCenterRadius.xyz;
+    Radius = radius;
+    Color = aColor;
+
+    // the quad lies on the plane through the front of the sphere, the camera looks down -z
+    float front = center.z + radius;
+    if (front > -1e-3) {
+        // the sphere reaches the camera, drop it
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        FragPos = aCenterRadius.xyz;
+        return;
+    }
+    // every point of the sphere projects onto that plane within these bounds,
+    // as its depth scales x and y by a factor in [k, 1]
+    float k = front / (center.z - radius);
+    vec2 lo = min(center.xy - radius, (center.xy - radius) * k);
+    vec2 hi = max(center.xy + radius, (center.xy + radius) * k);
+    vec3 corner = vec3(mix(lo, hi, aCorner * 0.5 + 0.5), front);
+
+    // back to world space, the view matrix is a rotation and a translation
+    FragPos = transpose(mat3(view)) * (corner - vec3(view[3]));
+    gl_Position = projection * vec4(corner, 1.0);
+}
@@ -0,0 +1,232 @@
+// draws all the balls with a single instanced draw call
+// the position, radius and colour of every ball come from a per-instance buffer
+// that is written once per frame straight into a streaming ring, and each ball is either the shared sphere mesh
+// or a quad the sphere is ray-cast on (an impostor)
+// the mesh comes in several levels of detail chosen per ball from its size on
+// screen, the instances are grouped by level and each level is one draw call
+
+#ifndef BALL_RENDERER_H
+#define BALL_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+#include "sphere.h"
+#include "detector.h"
+#include "stream_buffer.h"
+
+using namespace std;
+using namespace glm;
+
+// the layout of the instance attributes of resources/shader/ball.vs and impostor.vs
+struct BallInstance {
+	vec4 centerRadius; // xyz center, w radius
+	vec3 color;
+};
+
+enum BallRenderMode {
+	RENDER_MESH, // resources/shader/ball.vs and ball.fs
+	RENDER_IMPOSTOR // resources/shader/impostor.vs and impostor.fs
+};
+
+// corners of the impostor quad as a triangle strip
+const float IMPOSTOR_CORNERS[8] = {
+	-1.0f, -1.0f,
+	 1.0f, -1.0f,
+	-1.0f,  1.0f,
+	 1.0f,  1.0f
+};
+
+class BallRenderer {
+private:
+	unsigned int vao;
+	unsigned int meshVBO;
+	unsigned int meshEBO;
+	unsigned int quadVAO;
+	unsigned int quadVBO;
+	StreamBuffer instanceStream;
+	BallRenderMode mode;
+	vector<SphereLod> lods;
+	size_t numInstances; // written this frame, grouped by level of detail
+	vector<size_t> lodStart; // first instance of each level, with the total at the end
+	vector<size_t> lodNext;
+	vector<int> lodOf;
+
+	// advance once per ball instead of once per vertex, starting at instance first,
+	// in the segment of this frame, the vertex array must be bound
+	// gl 3.3 has no base instance, so the pointers are moved instead
+	void bindInstanceAttributes(size_t first = 0) const {
+		size_t offset = instanceStream.offset() + first * sizeof(BallInstance);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceStream.id());
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)(offset + offsetof(BallInstance, centerRadius)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribDivisor(2, 1);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)(offset + offsetof(BallInstance, color)));
+		glEnableVertexAttribArray(3);
+		glVertexAttribDivisor(3, 1);
+	}
+
+public:
+	BallRenderer() : vao(0), meshVBO(0), meshEBO(0), quadVAO(0), quadVBO(0),
+		mode(RENDER_IMPOSTOR), numInstances(0) {}
+
+	BallRenderer(const BallRenderer&) = delete;
+	BallRenderer& operator=(const BallRenderer&) = delete;
+
+	~BallRenderer() {
+		release();
+	}
+
+	// needs a current context, a sphere built without levels is drawn as a single level
+	// load is the loader glad was initialised with, used to find glBufferStorage
+	void init(const Sphere& sphere, GLADloadproc load = nullptr) {
+		lods = sphere.lods;
+		if (lods.empty()) {
+			SphereLod lod = { NUM_STACKS, NUM_SECTORS, 0, 0, (int)sphere.indices.size() };
+			lods.push_back(lod);
+		}
+		lodStart.assign(lods.size() + 1, 0);
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &meshVBO);
+		glGenBuffers(1, &meshEBO);
+		instanceStream.init(1024 * sizeof(BallInstance), load);
+		glGenVertexArrays(1, &quadVAO);
+		glGenBuffers(1, &quadVBO);
+
+		glBindVertexArray(vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+		glBufferData(GL_ARRAY_BUFFER, sphere.vertices.size() * sizeof(float), sphere.vertices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere.indices.size() * sizeof(int), sphere.indices.data(), GL_STATIC_DRAW);
+
+		bindInstanceAttributes();
+
+		glBindVertexArray(quadVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(IMPOSTOR_CORNERS), IMPOSTOR_CORNERS, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		bindInstanceAttributes();
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// the level of detail for a ball of the given radius at a view-space depth
+	// pixelScale is the projected size of one unit at depth one, in pixels
+	int selectLod(float radius, float depth, float pixelScale) const {
+		float pixels = depth > 0.0f ? radius * pixelScale / depth : pixelScale;
+		int lod = 0;
+		while (lod < (int)lods.size() - 1 && lod < NUM_SPHERE_LODS - 1 && pixels <= SPHERE_LOD_PIXELS[lod]) {
+			lod++;
+		}
+		return lod;
+	}
+
+	// write the balls of a snapshot, alpha of the way from prevPos to pos, into the instance
+	// buffer, only the visible ones if the snapshot was culled
+	// viewportHeight in pixels decides the levels of detail
+	void update(const BallSnapshot& frame, float alpha, const mat4& view, const mat4& projection, float viewportHeight) {
+		size_t n = frame.culled ? frame.visible.size() : frame.pos.size();
+
+		// a counting sort by level, impostors need no levels
+		lodOf.assign(n, 0);
+		if (mode == RENDER_MESH) {
+			float pixelScale = projection[1][1] * viewportHeight * 0.5f;
+			for (size_t i = 0; i < n; i++) {
+				size_t b = frame.culled ? (size_t)frame.visible[i] : i;
+				vec3 p = mix(frame.prevPos[b], frame.pos[b], alpha);
+				float depth = -(view[0][2] * p.x + view[1][2] * p.y + view[2][2] * p.z + view[3][2]);
+				lodOf[i] = selectLod(frame.radius[b], depth, pixelScale);
+			}
+		}
+		lodStart.assign(lods.size() + 1, 0);
+		for (size_t i = 0; i < n; i++) {
+			lodStart[lodOf[i] + 1]++;
+		}
+		for (size_t l = 0; l < lods.size(); l++) {
+			lodStart[l + 1] += lodStart[l];
+		}
+
+		// written once, straight into the buffer the gpu reads
+		BallInstance* out = (BallInstance*)instanceStream.begin(std::max(n, (size_t)1) * sizeof(BallInstance));
+		if (out == nullptr) {
+			cout << "ERROR: INSTANCE BUFFER UNABLE TO MAP!" << endl;
+			numInstances = 0;
+			return;
+		}
+		lodNext.assign(lodStart.begin(), lodStart.end() - 1);
+		for (size_t i = 0; i < n; i++) {
+			size_t b = frame.culled ? (size_t)frame.visible[i] : i;
+			BallInstance& instance = out[lodNext[lodOf[i]]++];
+			instance.centerRadius = vec4(mix(frame.prevPos[b], frame.pos[b], alpha), frame.radius[b]);
+			instance.color = frame.color[b];
+		}
+		instanceStream.end();
+		numInstances = n;
+	}
+
+	void setMode(BallRenderMode renderMode) {
+		mode = renderMode;
+	}
+
+	BallRenderMode getMode() const {
+		return mode;
+	}
+
+	bool isPersistentlyMapped() const {
+		return instanceStream.isPersistent();
+	}
+
+	// the shaders of the current mode must be in use, once after every update
+	void draw() {
+		if (numInstances == 0) {
+			instanceStream.fence();
+			return;
+		}
+		if (mode == RENDER_IMPOSTOR) {
+			glBindVertexArray(quadVAO);
+			bindInstanceAttributes();
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)numInstances);
+		}
+		else {
+			glBindVertexArray(vao);
+			for (size_t l = 0; l < lods.size(); l++) {
+				GLsizei count = (GLsizei)(lodStart[l + 1] - lodStart[l]);
+				if (count == 0) {
+					continue;
+				}
+				bindInstanceAttributes(lodStart[l]);
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[l].numIndices, GL_UNSIGNED_INT,
+					(void*)(lods[l].firstIndex * sizeof(int)), count, lods[l].baseVertex);
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		instanceStream.fence();
+	}
+
+	void release() {
+		if (vao != 0) {
+			glDeleteVertexArrays(1, &vao);
+			glDeleteBuffers(1, &meshVBO);
+			glDeleteBuffers(1, &meshEBO);
+			glDeleteVertexArrays(1, &quadVAO);
+			glDeleteBuffers(1, &quadVBO);
+		}
+		instanceStream.release();
+		vao = meshVBO = meshEBO = quadVAO = quadVBO = 0;
+		numInstances = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,251 @@
+// a bounding volume hierarchy over the triangles of a mesh
+// the nodes are stored depth first in one array, so the first child of an inner node
+// follows it and only the second child needs an index, and the leaves refer to
+// ranges of a triangle order array instead of holding triangles themselves
+// the layout is plain data so the tree can be written to and mapped from a file
+// nodes are split with the surface area heuristic evaluated over a fixed number of bins
+// reference: Ingo Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies", 2007
+// the upper levels hand one child to a new thread, whose nodes are appended afterwards
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "mesh.h"
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const int BVH_LEAF_SIZE = 4; // a node this small is always a leaf
+const int BVH_MAX_LEAF_SIZE = 16; // a node larger than this is always split
+const int BVH_BINS = 16;
+const float BVH_TRAVERSAL_COST = 1.0f; // of visiting a node, relative to testing a triangle
+const size_t BVH_PARALLEL_SIZE = 16384; // nodes with fewer triangles are built by one thread
+// from this depth on nodes are split at the median, so no tree is deeper than this plus 32
+// and a traversal stack of BVH_STACK_SIZE entries always suffices
+const int BVH_SAH_DEPTH = 60;
+const int BVH_STACK_SIZE = 96;
+
+struct BvhNode {
+	vec3 minPos;
+	uint32_t first; // first entry of the triangle order for a leaf, the second child for an inner node
+	vec3 maxPos;
+	uint32_t count; // triangles of a leaf, 0 for an inner node
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode is written to files as it is");
+
+// check a bvh read from a file: the nodes must form one depth first tree that a traversal
+// stack of BVH_STACK_SIZE entries can walk, and the leaves must refer to existing triangles
+inline bool isValidBvh(const BvhNode* nodes, size_t numNodes, const uint32_t* triangles, size_t numTriangles) {
+	if (numNodes == 0) {
+		return true;
+	}
+	// each node with the end of the range its subtree must fill
+	uint32_t stack[BVH_STACK_SIZE][2];
+	int top = 0;
+	stack[top][0] = 0;
+	stack[top++][1] = (uint32_t)numNodes;
+	while (top > 0) {
+		top--;
+		uint32_t i = stack[top][0], end = stack[top][1];
+		const BvhNode& node = nodes[i];
+		if (node.count > 0) {
+			if (end != i + 1 || node.first > numTriangles || node.count > numTriangles - node.first) {
+				return false;
+			}
+			continue;
+		}
+		if (node.first <= i + 1 || node.first >= end || top + 2 > BVH_STACK_SIZE) {
+			return false;
+		}
+		stack[top][0] = node.first;
+		stack[top++][1] = end;
+		stack[top][0] = i + 1;
+		stack[top++][1] = node.first;
+	}
+	for (size_t t = 0; t < numTriangles; t++) {
+		if (triangles[t] >= numTriangles) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline float boxArea(const vec3& minPos, const vec3& maxPos) {
+	vec3 e = glm::max(maxPos - minPos, vec3(0.0f));
+	return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+class Bvh {
+private:
+	vector<vec3> centroids;
+	vector<vec3> triMin;
+	vector<vec3> triMax;
+	int parallelDepth; // levels above which the second child gets its own thread
+
+	struct Bin {
+		vec3 minPos = vec3(INFINITY);
+		vec3 maxPos = vec3(-INFINITY);
+		size_t count = 0;
+	};
+
+	// pick where to split triangles[begin, end), return false to make a leaf
+	// on success triangles[begin, middle) go to the first child
+	bool split(size_t begin, size_t end, const vec3& minPos, const vec3& maxPos, int depth, size_t& middle) {
+		size_t n = end - begin;
+		if (n <= BVH_LEAF_SIZE) {
+			return false;
+		}
+		vec3 minCentroid(INFINITY), maxCentroid(-INFINITY);
+		for (size_t i = begin; i < end; i++) {
+			minCentroid = glm::min(minCentroid, centroids[triangles[i]]);
+			maxCentroid = glm::max(maxCentroid, centroids[triangles[i]]);
+		}
+		vec3 extent = maxCentroid - minCentroid;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		if (extent[axis] <= 0.0f) {
+			// all the centroids coincide, only the count can tell the children apart
+			if (n <= BVH_MAX_LEAF_SIZE) {
+				return false;
+			}
+			middle = begin + n / 2;
+			return true;
+		}
+		if (depth >= BVH_SAH_DEPTH) {
+			middle = begin + n / 2;
+			nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+				[this, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+			return true;
+		}
+
+		Bin bins[BVH_BINS];
+		float toBin = BVH_BINS / extent[axis] * 0.9999f;
+		float lo = minCentroid[axis];
+		for (size_t i = begin; i < end; i++) {
+			uint32_t t = triangles[i];
+			Bin& bin = bins[(int)((centroids[t][axis] - lo) * toBin)];
+			bin.minPos = glm::min(bin.minPos, triMin[t]);
+			bin.maxPos = glm::max(bin.maxPos, triMax[t]);
+			bin.count++;
+		}
+		// the area and count right of each boundary, then sweep from the left
+		float rightArea[BVH_BINS];
+		size_t rightCount[BVH_BINS];
+		Bin right;
+		for (int b = BVH_BINS - 1; b > 0; b--) {
+			right.minPos = glm::min(right.minPos, bins[b].minPos);
+			right.maxPos = glm::max(right.maxPos, bins[b].maxPos);
+			right.count += bins[b].count;
+			rightArea[b] = boxArea(right.minPos, right.maxPos);
+			rightCount[b] = right.count;
+		}
+		Bin left;
+		float bestCost = INFINITY;
+		int bestBin = 0;
+		for (int b = 1; b < BVH_BINS; b++) {
+			left.minPos = glm::min(left.minPos, bins[b - 1].minPos);
+			left.maxPos = glm::max(left.maxPos, bins[b - 1].maxPos);
+			left.count += bins[b - 1].count;
+			if (left.count == 0 || rightCount[b] == 0) {
+				continue;
+			}
+			float cost = boxArea(left.minPos, left.maxPos) * left.count + rightArea[b] * rightCount[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestBin = b;
+			}
+		}
+		float leafCost = boxArea(minPos, maxPos) * n;
+		bestCost += BVH_TRAVERSAL_COST * boxArea(minPos, maxPos);
+		if (bestBin == 0 || (bestCost >= leafCost && n <= BVH_MAX_LEAF_SIZE)) {
+			return false;
+		}
+		auto it = partition(triangles.begin() + begin, triangles.begin() + end,
+			[this, axis, lo, toBin, bestBin](uint32_t t) { return (int)((centroids[t][axis] - lo) * toBin) < bestBin; });
+		middle = it - triangles.begin();
+		return true;
+	}
+
+	// build the subtree over triangles[begin, end) at the end of out
+	void buildNode(size_t begin, size_t end, vector<BvhNode>& out, int depth = 0) {
+		size_t index = out.size();
+		out.push_back(BvhNode());
+		vec3 minPos(INFINITY), maxPos(-INFINITY);
+		for (size_t i = begin; i < end; i++) {
+			minPos = glm::min(minPos, triMin[triangles[i]]);
+			maxPos = glm::max(maxPos, triMax[triangles[i]]);
+		}
+		out[index].minPos = minPos;
+		out[index].maxPos = maxPos;
+		size_t middle;
+		if (!split(begin, end, minPos, maxPos, depth, middle)) {
+			out[index].first = (uint32_t)begin;
+			out[index].count = (uint32_t)(end - begin);
+			return;
+		}
+		out[index].count = 0;
+		if (end - begin < BVH_PARALLEL_SIZE || depth >= parallelDepth) {
+			buildNode(begin, middle, out, depth + 1);
+			out[index].first = (uint32_t)out.size();
+			buildNode(middle, end, out, depth + 1);
+			return;
+		}
+		// the second child on its own thread into its own array, the children
+		// partition disjoint ranges of the triangle order
+		vector<BvhNode> second;
+		thread worker([this, middle, end, depth, &second]() { buildNode(middle, end, second, depth + 1); });
+		buildNode(begin, middle, out, depth + 1);
+		worker.join();
+		uint32_t base = (uint32_t)out.size();
+		out[index].first = base;
+		for (auto& node : second) {
+			if (node.count == 0) {
+				node.first += base;
+			}
+			out.push_back(node);
+		}
+	}
+
+public:
+	vector<BvhNode> nodes; // the root first
+	vector<uint32_t> triangles; // the triangles of the leaves, in leaf order
+
+	Bvh() : parallelDepth(0) {}
+
+	void build(const Mesh& mesh) {
+		size_t n = mesh.numTriangles();
+		nodes.clear();
+		triangles.resize(n);
+		centroids.resize(n);
+		triMin.resize(n);
+		triMax.resize(n);
+		for (size_t t = 0; t < n; t++) {
+			vec3 a = mesh.vertex(mesh.indices[t * 3]);
+			vec3 b = mesh.vertex(mesh.indices[t * 3 + 1]);
+			vec3 c = mesh.vertex(mesh.indices[t * 3 + 2]);
+			triMin[t] = glm::min(a, glm::min(b, c));
+			triMax[t] = glm::max(a, glm::max(b, c));
+			centroids[t] = (triMin[t] + triMax[t]) * 0.5f;
+			triangles[t] = (uint32_t)t;
+		}
+		// about two threads per hardware thread
+		parallelDepth = 0;
+		while ((1u << parallelDepth) < thread::hardware_concurrency() * 2) {
+			parallelDepth++;
+		}
+		if (n > 0) {
+			nodes.reserve(n / BVH_LEAF_SIZE * 2 + 1);
+			buildNode(0, n, nodes);
+		}
+		vector<vec3>().swap(centroids);
+		vector<vec3>().swap(triMin);
+		vector<vec3>().swap(triMax);
+	}
+};
+
+#endif
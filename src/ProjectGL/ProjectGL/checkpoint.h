@@ -0,0 +1,210 @@
+// binary snapshots of the detector state
+// the file is a fixed header followed by page-aligned SoA arrays of the ball
+// attributes, so a restore maps the file and reads the arrays in place
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "global.h"
+#include "octree.h"
+#include "mapped_file.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const char CHECKPOINT_MAGIC[8] = { 'B', 'A', 'L', 'L', 'C', 'K', 'P', 'T' };
+const uint32_t CHECKPOINT_VERSION = 1;
+const uint32_t CHECKPOINT_ENDIAN_TAG = 0x01020304u;
+const size_t CHECKPOINT_ALIGNMENT = 4096;
+
+enum CheckpointSection {
+	SECTION_POS, SECTION_VELOCITY, SECTION_COLOR, SECTION_RADIUS, SECTION_MASS, SECTION_COR, NUM_SECTIONS
+};
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t endianTag; // reads differently on a machine of the other byte order
+	uint64_t numBalls;
+	uint64_t steps;
+	float boxSize;
+	int32_t maxDepth;
+	int32_t minBallsPerOctree;
+	int32_t maxBallsPerOctree;
+	uint64_t offsets[NUM_SECTIONS]; // from the start of the file
+	uint64_t fileSize;
+};
+
+inline size_t alignCheckpoint(size_t offset) {
+	return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+inline size_t sectionElementSize(int section) {
+	return section <= SECTION_COLOR ? sizeof(vec3) : sizeof(float);
+}
+
+// lay out the balls as the file stores them
+// done on the simulation thread so the balls can keep moving while the image is written
+void buildCheckpointImage(const vector<Ball*>& balls, long long steps, const OctreeParams& params, vector<char>& image) {
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.endianTag = CHECKPOINT_ENDIAN_TAG;
+	header.numBalls = balls.size();
+	header.steps = steps;
+	header.boxSize = SIZE;
+	header.maxDepth = params.maxDepth;
+	header.minBallsPerOctree = params.minBallsPerOctree;
+	header.maxBallsPerOctree = params.maxBallsPerOctree;
+
+	size_t offset = alignCheckpoint(sizeof(header));
+	for (int s = 0; s < NUM_SECTIONS; s++) {
+		header.offsets[s] = offset;
+		offset = alignCheckpoint(offset + balls.size() * sectionElementSize(s));
+	}
+	header.fileSize = offset;
+
+	image.assign(offset, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	vec3* pos = (vec3*)(image.data() + header.offsets[SECTION_POS]);
+	vec3* velocity = (vec3*)(image.data() + header.offsets[SECTION_VELOCITY]);
+	vec3* color = (vec3*)(image.data() + header.offsets[SECTION_COLOR]);
+	float* radius = (float*)(image.data() + header.offsets[SECTION_RADIUS]);
+	float* mass = (float*)(image.data() + header.offsets[SECTION_MASS]);
+	float* cor = (float*)(image.data() + header.offsets[SECTION_COR]);
+	for (size_t i = 0; i < balls.size(); i++) {
+		pos[i] = balls[i]->pos;
+		velocity[i] = balls[i]->velocity;
+		color[i] = balls[i]->color;
+		radius[i] = balls[i]->radius;
+		mass[i] = balls[i]->mass;
+		cor[i] = balls[i]->cor;
+	}
+}
+
+// write to a temporary file first so a crash never leaves a truncated checkpoint behind
+bool writeCheckpointImage(const string& path, const vector<char>& image) {
+	string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		remove(tmpPath.c_str());
+		return false;
+	}
+	// rename does not replace an existing file on windows
+	remove(path.c_str());
+	return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// writes checkpoint images on a background thread, one at a time
+class CheckpointWriter {
+private:
+	thread worker;
+	vector<char> image;
+	string path;
+	bool result;
+
+public:
+	CheckpointWriter() : result(true) {}
+
+	~CheckpointWriter() {
+		wait();
+	}
+
+	// takes over the image, waits for the previous write if it is still running
+	void save(const string& filePath, vector<char>& fileImage) {
+		wait();
+		path = filePath;
+		image.swap(fileImage);
+		worker = thread([this]() {
+			result = writeCheckpointImage(path, image);
+			if (!result) {
+				cout << "ERROR: CHECKPOINT UNABLE TO WRITE!" << endl;
+			}
+		});
+	}
+
+	// block until the pending write is done and return whether it succeeded
+	bool wait() {
+		if (worker.joinable()) {
+			worker.join();
+		}
+		return result;
+	}
+};
+
+// a checkpoint mapped into memory, the arrays point straight into the file
+class CheckpointView {
+private:
+	MappedFile file;
+	const CheckpointHeader* header;
+
+	template <typename T>
+	const T* section(int s) const {
+		return (const T*)(file.begin() + header->offsets[s]);
+	}
+
+public:
+	CheckpointView() : header(nullptr) {}
+
+	bool open(const char* path) {
+		header = nullptr;
+		if (!file.open(path)) {
+			cout << "ERROR: CHECKPOINT UNABLE TO LOAD!" << endl;
+			return false;
+		}
+		const CheckpointHeader* h = (const CheckpointHeader*)file.begin();
+		bool valid = file.size() >= sizeof(CheckpointHeader) &&
+			memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic)) == 0 &&
+			h->version == CHECKPOINT_VERSION &&
+			h->endianTag == CHECKPOINT_ENDIAN_TAG &&
+			h->fileSize == file.size() &&
+			h->boxSize == SIZE;
+		// divide rather than multiply, a huge count in a bad file would wrap the product
+		for (int s = 0; valid && s < NUM_SECTIONS; s++) {
+			valid = h->offsets[s] % CHECKPOINT_ALIGNMENT == 0 &&
+				h->offsets[s] <= file.size() &&
+				h->numBalls <= (file.size() - h->offsets[s]) / sectionElementSize(s);
+		}
+		if (!valid) {
+			cout << "ERROR: CHECKPOINT IS CORRUPT OR OF ANOTHER VERSION!" << endl;
+			file.close();
+			return false;
+		}
+		header = h;
+		return true;
+	}
+
+	size_t numBalls() const { return (size_t)header->numBalls; }
+	long long steps() const { return (long long)header->steps; }
+
+	OctreeParams octreeParams() const {
+		OctreeParams params;
+		params.maxDepth = header->maxDepth;
+		params.minBallsPerOctree = header->minBallsPerOctree;
+		params.maxBallsPerOctree = header->maxBallsPerOctree;
+		return params;
+	}
+
+	const vec3* positions() const { return section<vec3>(SECTION_POS); }
+	const vec3* velocities() const { return section<vec3>(SECTION_VELOCITY); }
+	const vec3* colors() const { return section<vec3>(SECTION_COLOR); }
+	const float* radii() const { return section<float>(SECTION_RADIUS); }
+	const float* masses() const { return section<float>(SECTION_MASS); }
+	const float* cors() const { return section<float>(SECTION_COR); }
+};
+
+#endif
@@ -11,20 +11,70 @@ using namespace std;
 using namespace glm;
 
 // define host data
-glm::vec3 pos[MAX_BALL_COUNT], velocity[MAX_BALL_COUNT];
-float mass[MAX_BALL_COUNT], radius[MAX_BALL_COUNT], cor[MAX_BALL_COUNT];
-int b1[MAX_COLLISIONS], b2[MAX_COLLISIONS];
-int b[MAX_COLLISIONS], p[MAX_COLLISIONS];
+vector<vec3> pos, velocity;
+vector<float> mass, radius, cor;
+vector<int> b1, b2;
+vector<int> b, p;
 
 // define device data
-__device__ glm::vec3 _pos[MAX_BALL_COUNT], _velocity[MAX_BALL_COUNT];
-__device__ float _mass[MAX_BALL_COUNT], _radius[MAX_BALL_COUNT], _cor[MAX_BALL_COUNT];
-__device__ int _b1[MAX_COLLISIONS], _b2[MAX_COLLISIONS];
-__device__ int _b[MAX_COLLISIONS], _p[MAX_COLLISIONS];
+// the buffers are allocated on demand so the scene size is only bounded by device memory,
+// the kernels read them through the pointer symbols below
+__device__ glm::vec3 *_pos, *_velocity;
+__device__ float *_mass, *_radius, *_cor;
+__device__ int *_b1, *_b2;
+__device__ int *_b, *_p;
+
+// device addresses held on the host side, with their capacities in elements
+vec3 *devPos = nullptr, *devVelocity = nullptr;
+float *devMass = nullptr, *devRadius = nullptr, *devCor = nullptr;
+int *devB1 = nullptr, *devB2 = nullptr;
+int *devB = nullptr, *devP = nullptr;
+int ballCapacity = 0, pairCapacity = 0, planePairCapacity = 0;
+
+// grow a device buffer and publish its address to the matching symbol
+template <typename T>
+void reserveDevice(T*& devPtr, T*& symbol, int n) {
+	cudaFree(devPtr);
+	cudaMalloc((void**)&devPtr, n * sizeof(T));
+	cudaMemcpyToSymbol(symbol, &devPtr, sizeof(T*), 0);
+}
+
+void reserveBalls(int n) {
+	if (n <= ballCapacity) {
+		return;
+	}
+	reserveDevice(devPos, _pos, n);
+	reserveDevice(devVelocity, _velocity, n);
+	reserveDevice(devMass, _mass, n);
+	reserveDevice(devRadius, _radius, n);
+	reserveDevice(devCor, _cor, n);
+	ballCapacity = n;
+}
+
+void reserveBallPairs(int n) {
+	if (n <= pairCapacity) {
+		return;
+	}
+	// grow geometrically as the number of pairs changes every step
+	n = std::max(n, pairCapacity * 2);
+	reserveDevice(devB1, _b1, n);
+	reserveDevice(devB2, _b2, n);
+	pairCapacity = n;
+}
+
+void reserveBallPlanePairs(int n) {
+	if (n <= planePairCapacity) {
+		return;
+	}
+	n = std::max(n, planePairCapacity * 2);
+	reserveDevice(devB, _b, n);
+	reserveDevice(devP, _p, n);
+	planePairCapacity = n;
+}
 
 // sychronize data between device and host 
 void reverseSyncVelocity(int n) {
-	cudaMemcpyFromSymbol(velocity, _velocity, n * sizeof(vec3));
+	cudaMemcpy(velocity.data(), devVelocity, n * sizeof(vec3), cudaMemcpyDeviceToHost);
 }
 
 __device__ void printv(vec3 val) {
@@ -36,28 +86,34 @@ __device__ void printfl(float val) {
 }
 
 void syncVars(int n) {
-	cudaMemcpyToSymbol(_pos, pos, n * sizeof(vec3), 0);
-	cudaMemcpyToSymbol(_velocity, velocity, n * sizeof(vec3), 0);
+	cudaMemcpy(devPos, pos.data(), n * sizeof(vec3), cudaMemcpyHostToDevice);
+	cudaMemcpy(devVelocity, velocity.data(), n * sizeof(vec3), cudaMemcpyHostToDevice);
 }
 
 void syncConsts(int n) {
-	cudaMemcpyToSymbol(_mass, mass, n * sizeof(float), 0);
-	cudaMemcpyToSymbol(_radius, radius, n * sizeof(float), 0);
-	cudaMemcpyToSymbol(_cor, cor, n * sizeof(float), 0);
+	cudaMemcpy(devMass, mass.data(), n * sizeof(float), cudaMemcpyHostToDevice);
+	cudaMemcpy(devRadius, radius.data(), n * sizeof(float), cudaMemcpyHostToDevice);
+	cudaMemcpy(devCor, cor.data(), n * sizeof(float), cudaMemcpyHostToDevice);
 }
 
 void syncBallPairs(int n) {
-	cudaMemcpyToSymbol(_b1, b1, n * sizeof(int), 0);
-	cudaMemcpyToSymbol(_b2, b2, n * sizeof(int), 0);
+	cudaMemcpy(devB1, b1.data(), n * sizeof(int), cudaMemcpyHostToDevice);
+	cudaMemcpy(devB2, b2.data(), n * sizeof(int), cudaMemcpyHostToDevice);
 }
 
 void syncBallPlanePairs(int n) {
-	cudaMemcpyToSymbol(_b, b, n * sizeof(int), 0);
-	cudaMemcpyToSymbol(_p, p, n * sizeof(int), 0);
+	cudaMemcpy(devB, b.data(), n * sizeof(int), cudaMemcpyHostToDevice);
+	cudaMemcpy(devP, p.data(), n * sizeof(int), cudaMemcpyHostToDevice);
 }
 
 // synchronization between cuda and detector class
-void initBallCuda(vector<Ball*> balls, int n) {
+void initBallCuda(const vector<Ball*>& balls, int n) {
+	pos.resize(n);
+	velocity.resize(n);
+	mass.resize(n);
+	radius.resize(n);
+	cor.resize(n);
+	reserveBalls(n);
     for (int i = 0; i < n; i++) {
         pos[i] = balls[i]->pos;
         velocity[i] = balls[i]->velocity;
@@ -69,7 +125,7 @@ void initBallCuda(vector<Ball*> balls, int n) {
 	syncVars(n);
 }
 
-void copyBallVarCuda(vector<Ball*> balls, int n) {
+void copyBallVarCuda(const vector<Ball*>& balls, int n) {
     for (int i = 0; i < n; i++) {
         pos[i] = balls[i]->pos;
         velocity[i] = balls[i]->velocity;
@@ -78,23 +134,29 @@ void copyBallVarCuda(vector<Ball*> balls, int n) {
 	return;
 }
 
-void updateVelocityCuda(vector<Ball*> balls, int n) {
+void updateVelocityCuda(const vector<Ball*>& balls, int n) {
 	reverseSyncVelocity(n);
     for (int i = 0; i < n; i++) {
 		balls[i]->velocity = velocity[i];
     }
 }
 
-void copyBallPairCuda(vector<BallPair> pairs, int numPairs) {
-    for (int i = 0; i < numPairs && i < MAX_COLLISIONS; i++) {
+void copyBallPairCuda(const vector<BallPair>& pairs, int numPairs) {
+	b1.resize(numPairs);
+	b2.resize(numPairs);
+	reserveBallPairs(numPairs);
+    for (int i = 0; i < numPairs; i++) {
         b1[i] = pairs[i].b1;
         b2[i] = pairs[i].b2;
     }
 	syncBallPairs(numPairs);
 }
 
-void copyBallPlanePairCuda(vector<BallPlanePair> pairs, int numPairs) {
-    for (int i = 0; i < numPairs && i < MAX_COLLISIONS; i++) {
+void copyBallPlanePairCuda(const vector<BallPlanePair>& pairs, int numPairs) {
+	b.resize(numPairs);
+	p.resize(numPairs);
+	reserveBallPlanePairs(numPairs);
+    for (int i = 0; i < numPairs; i++) {
         b[i] = pairs[i].b;
         p[i] = pairs[i].p;
     }
@@ -128,6 +190,9 @@ vec3 _planeDir(int p) {
 	}
 }
 
+// the kernels stride over the pairs so the grid does not need to cover all of them
+const int MAX_GRID_SIZE = 4096;
+
 // kernel functions
 __global__
 void ballCollideKernel(int numPairs) {
@@ -189,25 +254,29 @@ void ballPlaneCollideKernel(int numPairs) {
 }
 
 // interfaces to the detector
-void ballCollideCuda(vector<BallPair>& pairs, vector<Ball*> balls) {
-	int numBalls = balls.size();
+void ballCollideCuda(const vector<BallPair>& pairs, const vector<Ball*>& balls) {
 	int numPairs = pairs.size();
+	if (numPairs == 0) {
+		return;
+	}
 	copyBallPairCuda(pairs, numPairs);
 
 	dim3 blockSize(64);
-	dim3 gridSize((numBalls + blockSize.x - 1) / blockSize.x);
+	dim3 gridSize(std::min((numPairs + (int)blockSize.x - 1) / (int)blockSize.x, MAX_GRID_SIZE));
 
 	// call kernel function
 	ballCollideKernel <<<gridSize, blockSize>>> (numPairs);
 }
 
-void ballPlaneCollideCuda(vector<BallPlanePair>& pairs, vector<Ball*> balls) {
-	int numBalls = balls.size();
+void ballPlaneCollideCuda(const vector<BallPlanePair>& pairs, const vector<Ball*>& balls) {
 	int numPairs = pairs.size();
+	if (numPairs == 0) {
+		return;
+	}
 	copyBallPlanePairCuda(pairs, numPairs);
 
 	dim3 blockSize(64);
-	dim3 gridSize((numBalls + blockSize.x - 1) / blockSize.x);
+	dim3 gridSize(std::min((numPairs + (int)blockSize.x - 1) / (int)blockSize.x, MAX_GRID_SIZE));
 
 	// call kernel function
 	ballPlaneCollideKernel <<<gridSize, blockSize>>> (numPairs);
@@ -8,12 +8,12 @@
 #include <cstdio>
 
 
-void initBallCuda(vector<Ball*> balls, int numBalls);
-void copyBallVarCuda(vector<Ball*> balls, int numBalls);
-void updateVelocityCuda(vector<Ball*> balls, int numBalls);
-void copyBallPairCuda(vector<BallPair> pairs, int numPairs);
-void copyBallPlanePairCuda(vector<BallPlanePair> pairs, int numPairs);
-void ballCollideCuda(vector<BallPair>& pairs, vector<Ball*> balls);
-void ballPlaneCollideCuda(vector<BallPlanePair>& pairs, vector<Ball*> balls);
+void initBallCuda(const vector<Ball*>& balls, int numBalls);
+void copyBallVarCuda(const vector<Ball*>& balls, int numBalls);
+void updateVelocityCuda(const vector<Ball*>& balls, int numBalls);
+void copyBallPairCuda(const vector<BallPair>& pairs, int numPairs);
+void copyBallPlanePairCuda(const vector<BallPlanePair>& pairs, int numPairs);
+void ballCollideCuda(const vector<BallPair>& pairs, const vector<Ball*>& balls);
+void ballPlaneCollideCuda(const vector<BallPlanePair>& pairs, const vector<Ball*>& balls);
 
 #endif
\ No newline at end of file
@@ -2,21 +2,19 @@
 #define DETECTOR_H
 
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include "octree.h"
 #include "global.h"
 #include "collide.h"
+#include "scene.h"
+#include "checkpoint.h"
+#include "trajectory.h"
+#include "obstacle.h"
+#include "narrowphase.h"
 
 using namespace glm;
 
-// return a random float normalized to (0, 1)
-float randomFloat() {
-	return (float)rand() / ((float)RAND_MAX + 1);
-}
-
-vec3 randomVec() {
-	return vec3(randomFloat(), randomFloat(), randomFloat());
-}
-
 vec3 planeDir(int p) {
 	switch (p) {
 	case LEFT:
@@ -42,10 +40,102 @@ vec3 planeDir(int p) {
 	}
 }
 
+// broadphase efficiency of the last step
+struct BroadphaseStats {
+	int candidatePairs = 0; // pairs emitted by the octree, duplicates included
+	int uniquePairs = 0;
+	int duplicatePairs = 0; // the same pair found in more than one leaf
+	int contactPairs = 0; // unique pairs that actually overlap
+	int candidatePlanePairs = 0;
+	int obstacleContacts = 0; // balls touching a mesh obstacle
+	int partContacts = 0; // balls touching a part
+	long long splits = 0;
+	long long merges = 0;
+	OctreeStats tree;
+};
+
+// limits on the work done by one call to Detector::update
+// so a step slower than real time cannot make every frame slower than the last
+struct StepBudget {
+	int maxSteps = 8; // per update, 0 for no limit
+	float maxSeconds = 0.0f; // wall-clock time per update, 0 for no limit
+	bool timeDilation = true; // slow the simulated clock down while over budget
+	float minTimeScale = 0.1f;
+};
+
+struct StepBudgetStats {
+	int stepsLastUpdate = 0;
+	long long overBudgetUpdates = 0; // updates that could not catch up
+	double droppedTime = 0.0; // simulated seconds thrown away to catch up
+	double dilatedTime = 0.0; // simulated seconds not run because of time dilation
+	float timeScale = 1.0f; // simulated seconds per wall-clock second
+	float stepSeconds = 0.0f; // smoothed wall-clock cost of one step
+};
+
+// a copy of what the renderer needs, filled by the simulation thread
+// and never modified once published
+struct BallSnapshot {
+	vector<vec3> prevPos; // positions of the step before pos
+	vector<vec3> pos;
+	vector<float> radius;
+	vector<vec3> color;
+	long long steps = 0;
+	float alpha = 0.0f; // interpolation factor between prevPos and pos when filled
+	float timeScale = 1.0f; // simulated seconds per wall-clock second when filled
+	bool culled = false; // only the balls in visible are to be drawn
+	vector<int> visible;
+	double time = 0.0; // wall-clock seconds when published, set by the publisher
+};
+
+// a static part in the tree of the parts, with the box around its shape
+struct PartBox {
+	uint32_t part;
+	vec3 minPos;
+	vec3 maxPos;
+
+	bool operator<(const PartBox& o) const { return part < o.part; }
+	bool operator==(const PartBox& o) const { return part == o.part; }
+	bool operator!=(const PartBox& o) const { return part != o.part; }
+};
+
+struct PartBounds {
+	typedef BoxBound Bound;
+
+	static BoxBound bound(const PartBox& p) {
+		return BoxBound(p.minPos, p.maxPos);
+	}
+};
+
 class Detector {
 private:
 	vector<Ball*> balls;
 	Octree* octree;
+	bool statsEnabled;
+	BroadphaseStats stats;
+	long long lastSplits, lastMerges;
+	long long steps; // full simulation steps since the balls were generated
+	float accumulator; // simulated time not yet consumed by a full step
+	StepBudget budget;
+	StepBudgetStats budgetStats;
+	vector<vec3> prevPos; // positions before the last step
+	float maxRadius; // of all the balls, bounds how far a ball reaches out of its octree leaves
+	vector<char> visibleMark;
+	CheckpointWriter checkpointWriter;
+	vector<Obstacle*> obstacles;
+	vector<ObstacleContact> obstacleContacts;
+	// the static parts, and after the spheres among them the spheres of the balls that may
+	// touch them this step
+	ShapeSet shapes;
+	vector<ShapeRef> parts;
+	SpatialTree<PartBox, PartBounds> partTree; // their boxes clamped into the box of the tree
+	size_t partSpheres; // the spheres in shapes that are parts
+	vector<int> sphereBalls; // the ball of each sphere in shapes after the parts
+	vector<int> ballSpheres; // the sphere of each ball, -1 for none
+	vector<int> partStamp; // the last part a ball was paired with, a ball in several leaves is paired once
+	vector<ShapePair> partPairs;
+	vector<ShapeContact> partContacts;
+	Narrowphase narrowphase;
+	TrajectoryWriter* recorder; // receives the positions after every full step
 
 	void updateBallPos(float dt) {
 		for (auto b : balls) {
@@ -55,6 +145,27 @@ private:
 		}
 	}
 
+	void savePrevPos() {
+		prevPos.resize(balls.size());
+		for (size_t i = 0; i < balls.size(); i++) {
+			prevPos[i] = balls[i]->pos;
+		}
+	}
+
+	void updateMaxRadius() {
+		maxRadius = 0.0f;
+		for (auto b : balls) {
+			maxRadius = std::max(maxRadius, b->radius);
+		}
+	}
+
+	void clearBalls() {
+		for (auto b : balls) {
+			delete b;
+		}
+		balls.clear();
+	}
+
 	void accelerate() {
 		for (auto b : balls) {
 			b->velocity -= vec3(0.0f, G, 0.0f);
@@ -62,28 +173,214 @@ private:
 	}
 
 public:
-	Detector() { octree = new Octree(); }
-	~Detector() { delete octree; }
+	Detector(const OctreeParams& params=OctreeParams()) :
+		statsEnabled(false), lastSplits(0), lastMerges(0), steps(0), accumulator(0.0f), maxRadius(0.0f), partSpheres(0), recorder(nullptr)
+	{
+		octree = new Octree(MIN_POS, MAX_POS, params);
+	}
+	~Detector() {
+		clearBalls();
+		delete octree;
+		for (auto o : obstacles) {
+			delete o;
+		}
+	}
+
+	// add a static mesh the balls bounce off, scaled so its largest side is size and
+	// standing on base, return false if the model cannot be loaded
+	// a positive fieldResolution bakes a distance field with that many cells along the
+	// largest side, which replaces the bvh queries of the balls, and the balls collide with
+	// the given level of detail of the model
+	bool addObstacle(const char* path, const vec3& base, float size, int fieldResolution = 0, int collisionLevel = 0, int fieldChecks = 0) {
+		Obstacle* obstacle = new Obstacle();
+		if (!obstacle->load(path, base, size, collisionLevel)) {
+			delete obstacle;
+			return false;
+		}
+		if (fieldResolution > 0) {
+			obstacle->bakeField(fieldResolution);
+		}
+		if (fieldResolution > 0 && fieldChecks > 0) {
+			int checked;
+			int wrong = obstacle->checkField(fieldChecks, checked);
+			if (wrong > 0) {
+				cout << "WARNING: DISTANCE FIELD OF " << path << " HAS THE WRONG SIGN IN " << wrong << " OF " << checked << " CELLS!" << endl;
+			}
+			else {
+				cout << "distance field of " << path << " has the right sign in all " << checked << " cells checked" << endl;
+			}
+		}
+		// the models are static, so overlapping ones are only reported once
+		vector<MeshTrianglePair> pairs;
+		for (auto o : obstacles) {
+			MeshCollider collider;
+			if (collider.collide(o->getMesh(), o->pose(), obstacle->getMesh(), obstacle->pose(), pairs)) {
+				cout << "WARNING: OBSTACLE " << path << " INTERSECTS ANOTHER ONE IN " << pairs.size() << " TRIANGLE PAIRS!" << endl;
+				break;
+			}
+		}
+		obstacles.push_back(obstacle);
+		return true;
+	}
+
+	const vector<Obstacle*>& getObstacles() const {
+		return obstacles;
+	}
+
+	// add a static sphere, capsule or box the balls bounce off
+	template <typename S>
+	void addPart(const S& shape) {
+		shapes.spheres.resize(partSpheres);
+		ShapeRef ref = addShape(shapes, shape);
+		partSpheres = shapes.spheres.size();
+		// the parts are static, so overlapping ones are only reported once, the tree of the parts
+		// gives the ones whose boxes the new one reaches, a part in several leaves more than once,
+		// the boxes are clamped so the parts outside the world still meet in its border leaves
+		PartBox box;
+		box.part = (uint32_t)parts.size();
+		shapeBounds(shapes, ref, box.minPos, box.maxPos);
+		box.minPos = glm::clamp(box.minPos, MIN_POS, MAX_POS);
+		box.maxPos = glm::clamp(box.maxPos, MIN_POS, MAX_POS);
+		vector<uint32_t> reached;
+		partTree.visitBox(box.minPos, box.maxPos, [&reached](const PartBox& p) {
+			reached.push_back(p.part);
+		});
+		std::sort(reached.begin(), reached.end());
+		reached.erase(std::unique(reached.begin(), reached.end()), reached.end());
+		vector<ShapePair> pairs;
+		for (uint32_t p : reached) {
+			ShapePair pair = { parts[p], ref };
+			pairs.push_back(pair);
+		}
+		vector<ShapeContact> contacts;
+		narrowphase.collide(shapes, pairs, contacts);
+		if (!contacts.empty()) {
+			cout << "WARNING: PART " << parts.size() << " INTERSECTS " << contacts.size() << " OTHER ONES!" << endl;
+		}
+		partTree.insert(box);
+		parts.push_back(ref);
+	}
+
+	const vector<ShapeRef>& getParts() const {
+		return parts;
+	}
+
+	const ShapeSet& getShapes() const {
+		return shapes;
+	}
 
 	void generateBalls(int numBalls) {
-		for (int i = 0; i < numBalls; i++) {
-			Ball* b = new Ball();
-			int index1, index2, index3;
-			index1 = i / (NUM_SQUARE);
-			index2 = (i - index1 * NUM_SQUARE) / NUM_DIM;
-			index3 = i - index1 * NUM_SQUARE - index2 * NUM_DIM;
-			b->pos = vec3(-2.0f, -2.0f, -2.0f) + vec3(index1 * 2 * MAX_RADIUS + EPS, index2 * 2 * MAX_RADIUS + EPS, index3 * 2 * MAX_RADIUS + EPS);
-			b->velocity = randomVec() * (MAX_SPEED - MIN_SPEED) + MIN_SPEED;
-			b->radius = randomFloat() * (MAX_RADIUS - MIN_RADIUS) + MIN_RADIUS;
-			b->mass = randomFloat() * (MAX_MASS - MIN_MASS) + MIN_MASS;
-			b->cor = randomFloat() * (MAX_COR - MIN_COR) + MIN_COR;
-			b->color = randomVec() * 0.6f + 0.2f;
-			b->index = i;
-			balls.push_back(b);
+		SceneSpec spec;
+		spec.numBalls = numBalls;
+		spec.octree = octree->getParams();
+		generateBalls(spec);
+	}
+
+	// replace the current balls with a generated scene, the octree is rebuilt with the scene parameters
+	void generateBalls(const SceneSpec& spec) {
+		clearBalls();
+		delete octree;
+		octree = new Octree(MIN_POS, MAX_POS, spec.octree);
+		SceneGenerator generator(spec);
+		generator.generate(balls);
+		for (auto b : balls) {
 			octree->insert(b);
 		}
+		lastSplits = octree->getSplits();
+		lastMerges = octree->getMerges();
+		steps = 0;
+		accumulator = 0.0f;
+		savePrevPos();
+		updateMaxRadius();
 		// cuda function to copy the ball information to cuda device
-		initBallCuda(balls, numBalls);
+		initBallCuda(balls, balls.size());
+	}
+
+	// snapshot the balls now and write them on a background thread
+	void saveCheckpoint(const char* path) {
+		vector<char> image;
+		buildCheckpointImage(balls, steps, octree->getParams(), image);
+		checkpointWriter.save(path, image);
+	}
+
+	// wait for the pending checkpoint write, return whether it succeeded
+	bool waitCheckpoint() {
+		return checkpointWriter.wait();
+	}
+
+	// replace the current balls with a checkpoint, the detector is left untouched on failure
+	bool loadCheckpoint(const char* path) {
+		CheckpointView view;
+		if (!view.open(path)) {
+			return false;
+		}
+		clearBalls();
+		delete octree;
+		octree = new Octree(MIN_POS, MAX_POS, view.octreeParams());
+		const vec3* pos = view.positions();
+		const vec3* velocity = view.velocities();
+		const vec3* color = view.colors();
+		const float* radius = view.radii();
+		const float* mass = view.masses();
+		const float* cor = view.cors();
+		balls.resize(view.numBalls());
+		for (size_t i = 0; i < balls.size(); i++) {
+			Ball* b = new Ball();
+			b->pos = pos[i];
+			b->velocity = velocity[i];
+			b->color = color[i];
+			b->radius = radius[i];
+			b->mass = mass[i];
+			b->cor = cor[i];
+			b->index = (int)i;
+			balls[i] = b;
+			octree->insert(b);
+		}
+		lastSplits = octree->getSplits();
+		lastMerges = octree->getMerges();
+		steps = view.steps();
+		accumulator = 0.0f;
+		savePrevPos();
+		updateMaxRadius();
+		initBallCuda(balls, balls.size());
+		return true;
+	}
+
+	// gather the broadphase counters of the current step
+	// the pair list is sorted on a copy so the order sent to the narrowphase is untouched
+	void collectStats(const vector<BallPair>& pairs, const vector<BallPlanePair>& planePairs) {
+		stats = BroadphaseStats();
+		stats.candidatePairs = (int)pairs.size();
+		stats.candidatePlanePairs = (int)planePairs.size();
+
+		vector<unsigned long long> keys;
+		keys.reserve(pairs.size());
+		for (auto pair : pairs) {
+			unsigned long long lo = (unsigned)std::min(pair.b1, pair.b2);
+			unsigned long long hi = (unsigned)std::max(pair.b1, pair.b2);
+			keys.push_back(hi << 32 | lo);
+		}
+		sort(keys.begin(), keys.end());
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (i > 0 && keys[i] == keys[i - 1]) {
+				stats.duplicatePairs++;
+				continue;
+			}
+			stats.uniquePairs++;
+			Ball* b1 = balls[(int)(keys[i] >> 32)];
+			Ball* b2 = balls[(int)(keys[i] & 0xffffffffu)];
+			vec3 dp = b1->pos - b2->pos;
+			float r = b1->radius + b2->radius;
+			if (dot(dp, dp) < r * r) {
+				stats.contactPairs++;
+			}
+		}
+
+		stats.splits = octree->getSplits() - lastSplits;
+		stats.merges = octree->getMerges() - lastMerges;
+		lastSplits = octree->getSplits();
+		lastMerges = octree->getMerges();
+		octree->collectStats(stats.tree);
 	}
 
 	void ballCollideCpu(vector<BallPair> pairs) {
@@ -97,7 +394,7 @@ public:
 			float m1 = b1->mass;
 			float m2 = b2->mass;
 			vec3 dv = v1 - v2;
-			float c = min(b1->cor, b2->cor);
+			float c = glm::min(b1->cor, b2->cor);
 			if (dot(dp, dp) < r * r && dot(dv, dp) < EPS) {
 				vec3 vec1 = dot(v1, dp) * dp;
 				vec3 vec2 = dot(v2, dp) * dp;
@@ -120,46 +417,246 @@ public:
 		}
 	}
 	
+	// the same response as a wall, along the normal of the nearest point of the mesh
+	void obstacleCollideCpu() {
+		obstacleContacts.clear();
+		for (auto o : obstacles) {
+			o->findContacts(balls, obstacleContacts);
+		}
+		for (auto& contact : obstacleContacts) {
+			Ball* b = balls[contact.ball];
+			float vn = dot(b->velocity, contact.normal);
+			if (vn < 0) {
+				b->velocity -= vec3(1 + b->cor) * contact.normal * vn;
+			}
+		}
+		if (statsEnabled) {
+			stats.obstacleContacts = (int)obstacleContacts.size();
+		}
+	}
+
+	// the same response as a wall, the balls near each part are found through the octree and
+	// all their pairs go through the narrowphase in one batch
+	void partCollideCpu() {
+		if (parts.empty()) {
+			return;
+		}
+		shapes.spheres.resize(partSpheres);
+		sphereBalls.clear();
+		partPairs.clear();
+		ballSpheres.resize(balls.size(), -1);
+		partStamp.resize(balls.size(), -1);
+		for (size_t i = 0; i < parts.size(); i++) {
+			vec3 lo, hi;
+			shapeBounds(shapes, parts[i], lo, hi);
+			octree->visitBox(lo, hi, [this, i](Ball* b) {
+				if (partStamp[b->index] == (int)i) {
+					return;
+				}
+				partStamp[b->index] = (int)i;
+				if (ballSpheres[b->index] < 0) {
+					ballSpheres[b->index] = (int)(partSpheres + sphereBalls.size());
+					sphereBalls.push_back(b->index);
+					shapes.spheres.push_back(SphereShape(b->pos, b->radius));
+				}
+				ShapePair pair = { { SHAPE_SPHERE, (uint32_t)ballSpheres[b->index] }, parts[i] };
+				partPairs.push_back(pair);
+			});
+		}
+		for (int b : sphereBalls) {
+			ballSpheres[b] = -1;
+			partStamp[b] = -1;
+		}
+		narrowphase.collide(shapes, partPairs, partContacts);
+		for (auto& contact : partContacts) {
+			Ball* b = balls[sphereBalls[contact.a.index - partSpheres]];
+			float vn = dot(b->velocity, contact.normal);
+			if (vn < 0) {
+				b->velocity -= vec3(1 + b->cor) * contact.normal * vn;
+			}
+		}
+		if (statsEnabled) {
+			stats.partContacts = (int)partContacts.size();
+		}
+	}
+
 	void updateBallAttr() {
 		accelerate();
 		copyBallVarCuda(balls, balls.size());
 		vector<BallPair> bps;
 		octree->candidateBallCollision(bps);
-		ballCollideCuda(bps, balls);
 		vector<BallPlanePair> bpps;
 		octree->candidateBallPlaneCollision(bpps);
+		if (statsEnabled) {
+			collectStats(bps, bpps);
+		}
+		ballCollideCuda(bps, balls);
 		ballPlaneCollideCuda(bpps, balls);
 		updateVelocityCuda(balls, balls.size());
+		obstacleCollideCpu();
+		partCollideCpu();
+		steps++;
 	}
 
 	void updateBallAttrCpu() {
 		accelerate();
 		vector<BallPair> bps;
 		octree->candidateBallCollision(bps);
-		ballCollideCpu(bps);
 		vector<BallPlanePair> bpps;
 		octree->candidateBallPlaneCollision(bpps);
+		if (statsEnabled) {
+			collectStats(bps, bpps);
+		}
+		ballCollideCpu(bps);
 		ballPlaneCollideCpu(bpps);
+		obstacleCollideCpu();
+		partCollideCpu();
+		steps++;
 	}
 
-	void update(float t, float& dt) {
-		while (t > 0) {
-			if (dt <= t) {
-				updateBallPos(dt);
-				updateBallAttr();
-				t -= dt;
-				dt = UPDATE_INTERVAL;
+	// advance by t seconds in full steps of UPDATE_INTERVAL, the remainder is carried
+	// to the next call and the renderer interpolates across it with getAlpha()
+	// the step budget bounds the work per call, time that cannot be caught up is dropped
+	void update(float t) {
+		float scaled = t * budgetStats.timeScale;
+		budgetStats.dilatedTime += t - scaled;
+		accumulator += scaled;
+
+		auto start = chrono::steady_clock::now();
+		int taken = 0;
+		while (accumulator >= UPDATE_INTERVAL) {
+			if (budget.maxSteps > 0 && taken >= budget.maxSteps) {
+				break;
 			}
-			else {
-				updateBallPos(t);
-				dt -= t;
-				t = 0;
+			float elapsed = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+			if (budget.maxSeconds > 0 && taken > 0 && elapsed + budgetStats.stepSeconds > budget.maxSeconds) {
+				break;
 			}
+			auto stepStart = chrono::steady_clock::now();
+			savePrevPos();
+			updateBallPos(UPDATE_INTERVAL);
+			updateBallAttr();
+			if (recorder != nullptr) {
+				recorder->record(balls);
+			}
+			accumulator -= UPDATE_INTERVAL;
+			taken++;
+			float stepSeconds = chrono::duration<float>(chrono::steady_clock::now() - stepStart).count();
+			budgetStats.stepSeconds = budgetStats.stepSeconds == 0.0f ? stepSeconds : 0.9f * budgetStats.stepSeconds + 0.1f * stepSeconds;
+		}
+		budgetStats.stepsLastUpdate = taken;
+
+		if (accumulator >= UPDATE_INTERVAL) {
+			// keep only the fraction for interpolation
+			float kept = fmodf(accumulator, UPDATE_INTERVAL);
+			budgetStats.droppedTime += accumulator - kept;
+			budgetStats.overBudgetUpdates++;
+			accumulator = kept;
+			if (budget.timeDilation) {
+				budgetStats.timeScale = std::max(budget.minTimeScale, budgetStats.timeScale * 0.8f);
+			}
+		}
+		else if (budget.timeDilation) {
+			// recover slowly so a single fast update does not bring the overload back
+			budgetStats.timeScale = std::min(1.0f, budgetStats.timeScale * 1.02f);
 		}
 	}
+
+	void setStepBudget(const StepBudget& stepBudget) {
+		budget = stepBudget;
+		if (!budget.timeDilation) {
+			budgetStats.timeScale = 1.0f;
+		}
+	}
+
+	const StepBudgetStats& getStepBudgetStats() const {
+		return budgetStats;
+	}
+
+	// how far the carried time is between the previous and the current step, in [0, 1)
+	float getAlpha() const {
+		return accumulator / UPDATE_INTERVAL;
+	}
+
+	// positions at a fraction alpha of the way from the previous step to the current one
+	void getInterpolatedPositions(float alpha, vector<vec3>& positions) const {
+		positions.resize(balls.size());
+		for (size_t i = 0; i < balls.size(); i++) {
+			positions[i] = mix(prevPos[i], balls[i]->pos, alpha);
+		}
+	}
+
+	// time until the next step is due
+	float getTimeToNextStep() const {
+		return UPDATE_INTERVAL - accumulator;
+	}
 	
 	vector<Ball*>& getBalls() {
 		return balls;
 	}
+
+	void fillSnapshot(BallSnapshot& snapshot) const {
+		size_t n = balls.size();
+		snapshot.prevPos = prevPos;
+		snapshot.pos.resize(n);
+		snapshot.radius.resize(n);
+		snapshot.color.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			snapshot.pos[i] = balls[i]->pos;
+			snapshot.radius[i] = balls[i]->radius;
+			snapshot.color[i] = balls[i]->color;
+		}
+		snapshot.steps = steps;
+		snapshot.alpha = getAlpha();
+		snapshot.timeScale = budgetStats.timeScale;
+		snapshot.culled = false;
+	}
+
+	// the indices of the balls that may be inside the frustum, each once, found through the octree
+	// margin widens the tests to cover the motion until the balls are drawn
+	void cullBalls(const Frustum& frustum, float margin, vector<int>& visible) {
+		visible.clear();
+		octree->queryFrustum(frustum, maxRadius, margin, visible);
+		// drop the repeats of balls straddling several leaves, the marks are cleared
+		// again afterwards so the cost stays proportional to the visible balls
+		visibleMark.resize(balls.size(), 0);
+		size_t n = 0;
+		for (size_t i = 0; i < visible.size(); i++) {
+			if (!visibleMark[visible[i]]) {
+				visibleMark[visible[i]] = 1;
+				visible[n++] = visible[i];
+			}
+		}
+		visible.resize(n);
+		for (int i : visible) {
+			visibleMark[i] = 0;
+		}
+	}
+
+	// the counters are only gathered while enabled as they cost an extra pass over the pairs
+	void setStatsEnabled(bool enabled) {
+		statsEnabled = enabled;
+		lastSplits = octree->getSplits();
+		lastMerges = octree->getMerges();
+	}
+
+	// splits and merges cover every octree update since the previous step,
+	// the other counters describe the pairs of the last step
+	const BroadphaseStats& getStats() const {
+		return stats;
+	}
+
+	// record every full step into the writer, nullptr stops the recording
+	void setRecorder(TrajectoryWriter* writer) {
+		recorder = writer;
+	}
+
+	long long getSteps() const {
+		return steps;
+	}
+
+	const OctreeParams& getOctreeParams() const {
+		return octree->getParams();
+	}
 };
 #endif
\ No newline at end of file
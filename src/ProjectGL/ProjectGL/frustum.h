@@ -0,0 +1,111 @@
+// the view frustum of a camera and tests of boxes and spheres against it
+// reference: Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix", 2001
+// the planes are kept as separate x, y, z, w arrays so four of them are tested at once with sse
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace glm;
+
+enum FrustumTest {
+	FRUSTUM_OUTSIDE, FRUSTUM_INTERSECT, FRUSTUM_INSIDE
+};
+
+// six planes padded to eight, a point p is inside when dot(n, p) + w >= 0 for all of them
+// the padding planes (0, 0, 0, 1) accept everything
+struct Frustum {
+	alignas(16) float nx[8];
+	alignas(16) float ny[8];
+	alignas(16) float nz[8];
+	alignas(16) float w[8];
+};
+
+// planes of a projection * view matrix, normals pointing inwards and of unit length
+inline Frustum extractFrustum(const mat4& viewProjection) {
+	Frustum f;
+	// glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	vec4 row[4];
+	for (int i = 0; i < 4; i++) {
+		row[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	vec4 planes[6] = {
+		row[3] + row[0], row[3] - row[0], // left, right
+		row[3] + row[1], row[3] - row[1], // bottom, top
+		row[3] + row[2], row[3] - row[2] // near, far
+	};
+	for (int i = 0; i < 8; i++) {
+		vec4 p = i < 6 ? planes[i] / length(vec3(planes[i])) : vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		f.nx[i] = p.x;
+		f.ny[i] = p.y;
+		f.nz[i] = p.z;
+		f.w[i] = p.w;
+	}
+	return f;
+}
+
+// classify the box [minPos - margin, maxPos + margin]
+// the signed distance of the center to each plane is compared with the projected half size
+inline FrustumTest classifyBox(const Frustum& f, const vec3& minPos, const vec3& maxPos, float margin = 0.0f) {
+	vec3 c = (minPos + maxPos) * 0.5f;
+	vec3 e = (maxPos - minPos) * 0.5f + vec3(margin);
+#ifdef FRUSTUM_SSE
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+	__m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+	int outside = 0, intersect = 0;
+	for (int i = 0; i < 8; i += 4) {
+		__m128 nx = _mm_load_ps(f.nx + i), ny = _mm_load_ps(f.ny + i), nz = _mm_load_ps(f.nz + i);
+		__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+			_mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(f.w + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, nx), ex), _mm_mul_ps(_mm_andnot_ps(sign, ny), ey)),
+			_mm_mul_ps(_mm_andnot_ps(sign, nz), ez));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+		intersect |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, radius), _mm_setzero_ps()));
+	}
+#else
+	int outside = 0, intersect = 0;
+	for (int i = 0; i < 6; i++) {
+		float dist = f.nx[i] * c.x + f.ny[i] * c.y + f.nz[i] * c.z + f.w[i];
+		float radius = fabsf(f.nx[i]) * e.x + fabsf(f.ny[i]) * e.y + fabsf(f.nz[i]) * e.z;
+		outside |= dist + radius < 0.0f;
+		intersect |= dist - radius < 0.0f;
+	}
+#endif
+	if (outside) {
+		return FRUSTUM_OUTSIDE;
+	}
+	return intersect ? FRUSTUM_INTERSECT : FRUSTUM_INSIDE;
+}
+
+// whether any part of the sphere may be visible
+inline bool sphereInFrustum(const Frustum& f, const vec3& center, float radius) {
+#ifdef FRUSTUM_SSE
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	__m128 r = _mm_set1_ps(-radius);
+	int outside = 0;
+	for (int i = 0; i < 8; i += 4) {
+		__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(f.nx + i), cx), _mm_mul_ps(_mm_load_ps(f.ny + i), cy)),
+			_mm_add_ps(_mm_mul_ps(_mm_load_ps(f.nz + i), cz), _mm_load_ps(f.w + i)));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(dist, r));
+	}
+	return outside == 0;
+#else
+	for (int i = 0; i < 6; i++) {
+		if (f.nx[i] * center.x + f.ny[i] * center.y + f.nz[i] * center.z + f.w[i] < -radius) {
+			return false;
+		}
+	}
+	return true;
+#endif
+}
+
+#endif
@@ -24,12 +24,15 @@ const float MAX_COR = 1.0f;
 const float MIN_COR = 0.5f;
 const float MAX_SPEED = 1.0f;
 const float MIN_SPEED = 0.3f;
-__constant__ const int MAX_BALL_COUNT = (int)1e4;
-const int MAX_COLLISIONS = (int)1e7;
 
 // sphere modeling
 const int NUM_STACKS = 40;
 const int NUM_SECTORS = 40;
+// levels of detail, from the finest, with the projected radius in pixels above which
+// each level is used (the last one is used below every threshold)
+const int NUM_SPHERE_LODS = 4;
+const int SPHERE_LOD_SECTORS[NUM_SPHERE_LODS] = { NUM_SECTORS, 20, 12, 6 };
+const float SPHERE_LOD_PIXELS[NUM_SPHERE_LODS - 1] = { 40.0f, 15.0f, 4.0f };
 const float PI = acosf(-1);
 
 // environment physics
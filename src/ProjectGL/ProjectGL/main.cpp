@@ -11,6 +11,17 @@
 #include "global.h"
 #include "sphere.h"
 #include "detector.h"
+#include "scene.h"
+#include "triple_buffer.h"
+#include "ball_renderer.h"
+#include "offscreen.h"
+#include "uniform_buffer.h"
+#include "mesh_renderer.h"
+#include "point_renderer.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include <iostream>
 
 #define MOVABLE_CAM true
@@ -20,12 +31,22 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
 
 // С
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// the uniforms set every frame, constexpr so their names are hashed when compiling
+constexpr UniformName MODEL_UNIFORM("model");
+constexpr UniformName SHININESS_UNIFORM("shininess");
+constexpr UniformName COLOR_UNIFORM("color");
+constexpr UniformName MATERIAL_AMBIENT_UNIFORM("material.ambient");
+constexpr UniformName MATERIAL_DIFFUSE_UNIFORM("material.diffuse");
+constexpr UniformName MATERIAL_SPECULAR_UNIFORM("material.specular");
+constexpr UniformName MATERIAL_SHININESS_UNIFORM("material.shininess");
+
 
 // 
 Camera camera(glm::vec3(0.0f, 0.0f, 10.0f));
@@ -36,25 +57,310 @@ bool firstMouse = true;
 // ײ
 Detector detector;
 
+// options of the application itself, every other option describes the scene
+struct AppOptions {
+	string restorePath; // start from this checkpoint instead of a generated scene
+	string checkpointPath = "checkpoint.bin"; // written when F5 is pressed
+	string recordPath; // record every simulation step into this trajectory
+	string replayPath; // play this trajectory instead of simulating
+	StepBudget budget; // how much the simulation may do to catch up with real time
+	BallRenderMode renderMode = RENDER_IMPOSTOR; // switched with tab
+	bool cull = true; // only hand the balls inside the view frustum to the renderer
+	// without a display, frames are rendered offscreen and written to files
+	string headlessDir; // frame_<number>.ppm are written into this existing directory
+	int frames = 600;
+	float fps = 60.0f; // simulated time between frames is 1 / fps
+	int width = 800;
+	int height = 600;
+	string context = "native"; // native, egl or osmesa
+	vector<string> obstaclePaths; // PLY models the balls collide with
+	float obstacleSize = SIZE / 2; // largest side of each model in the box
+	int obstacleField = 0; // cells of the distance field along the largest side, 0 for none
+	int obstacleFieldChecks = 0; // cells of the field checked against the winding number
+	int obstacleLod = 0; // level of detail the balls collide with, 0 for the full mesh
+	string pointsPath; // PLY scan drawn as a point cloud, streamed from disk as the camera moves
+	vector<CapsuleShape> capsules; // static parts the balls collide with
+	vector<BoxShape> boxes;
+	float pointsBudget = 256.0f; // megabytes of points the cloud keeps in memory
+};
+AppOptions options;
+
+// trajectory recording and replay
+TrajectoryWriter recorder;
+TrajectoryReader replay;
+bool replaying = false;
+bool replayJumped = false; // set by the keys that seek, the next frame is not drawn from the last one
+
+// the simulation runs on its own thread and publishes snapshots of the balls,
+// so a slow step never drops a frame and a slow frame never stalls the physics
+TripleBuffer<BallSnapshot> snapshots;
+atomic<bool> simulating(false);
+atomic<bool> checkpointRequested(false); // the detector is only touched by the simulation thread
+
+// the frustum of the last frame drawn, culled against on the simulation thread
+// the tests are widened by this much to cover the camera and balls moving until the next frame
+const float CULL_MARGIN = 0.5f;
+mutex cullMutex;
+Frustum cullFrustum;
+bool cullReady = false;
+
+double wallTime()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// advance the detector by t seconds and take a snapshot of it, culled with the last frame's frustum
+void simulateStep(float t, BallSnapshot& snapshot)
+{
+	detector.update(t);
+	if (checkpointRequested.exchange(false)) {
+		detector.saveCheckpoint(options.checkpointPath.c_str());
+	}
+	detector.fillSnapshot(snapshot);
+	if (options.cull) {
+		Frustum frustum;
+		bool ready;
+		{
+			lock_guard<mutex> lock(cullMutex);
+			frustum = cullFrustum;
+			ready = cullReady;
+		}
+		if (ready) {
+			detector.cullBalls(frustum, CULL_MARGIN, snapshot.visible);
+			snapshot.culled = true;
+		}
+	}
+}
+
+void simulate()
+{
+	double last = wallTime();
+	while (simulating) {
+		double now = wallTime();
+		BallSnapshot& snapshot = snapshots.writeBuffer();
+		simulateStep((float)(now - last), snapshot);
+		last = now;
+		snapshot.time = now;
+		snapshots.publish();
+		this_thread::sleep_for(chrono::duration<float>(detector.getTimeToNextStep()));
+	}
+}
+
+// parse an option value, numbers can be required to be above a minimum
+template <typename T>
+bool parseValue(const string& key, const string& value, T& result) {
+	stringstream in(value);
+	if (!(in >> result)) {
+		cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+		return false;
+	}
+	return true;
+}
+
+// parse a comma separated list of count numbers, or of count - 1 when the last one is optional
+bool parseList(const string& key, const string& value, vector<float>& result, size_t count, bool lastOptional = false) {
+	result.clear();
+	stringstream in(value);
+	string item;
+	while (getline(in, item, ',')) {
+		stringstream number(item);
+		float x;
+		if (!(number >> x)) {
+			result.clear();
+			break;
+		}
+		result.push_back(x);
+	}
+	if (result.size() != count && !(lastOptional && result.size() == count - 1)) {
+		cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+		return false;
+	}
+	return true;
+}
+
+template <typename T>
+bool parseValue(const string& key, const string& value, T& result, T above) {
+	if (!parseValue(key, value, result)) {
+		return false;
+	}
+	if (!(result > above)) {
+		cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool parseArgs(int argc, char** argv, SceneSpec& scene) {
+	bool ok = true;
+	for (int i = 1; i < argc; i++) {
+		string key, value;
+		if (!splitArg(argv[i], key, value)) {
+			continue;
+		}
+		if (key == "restore") {
+			options.restorePath = value;
+		}
+		else if (key == "checkpoint") {
+			options.checkpointPath = value;
+		}
+		else if (key == "record") {
+			options.recordPath = value;
+		}
+		else if (key == "replay") {
+			options.replayPath = value;
+		}
+		else if (key == "render") {
+			if (value == "mesh") options.renderMode = RENDER_MESH;
+			else if (value == "impostor") options.renderMode = RENDER_IMPOSTOR;
+			else {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+		}
+		else if (key == "cull") {
+			ok = parseValue(key, value, options.cull) && ok;
+		}
+		else if (key == "headless") {
+			options.headlessDir = value;
+		}
+		else if (key == "frames") {
+			ok = parseValue(key, value, options.frames) && ok;
+		}
+		else if (key == "fps") {
+			ok = parseValue(key, value, options.fps, 0.0f) && ok;
+		}
+		else if (key == "width") {
+			ok = parseValue(key, value, options.width, 0) && ok;
+		}
+		else if (key == "height") {
+			ok = parseValue(key, value, options.height, 0) && ok;
+		}
+		else if (key == "context") {
+			if (value == "native" || value == "egl" || value == "osmesa") {
+				options.context = value;
+			}
+			else {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+		}
+		else if (key == "obstacle") {
+			options.obstaclePaths.push_back(value);
+		}
+		else if (key == "obstacle_size") {
+			ok = parseValue(key, value, options.obstacleSize, 0.0f) && ok;
+		}
+		else if (key == "obstacle_sdf") {
+			ok = parseValue(key, value, options.obstacleField, 0) && ok;
+		}
+		else if (key == "obstacle_sdf_check") {
+			ok = parseValue(key, value, options.obstacleFieldChecks, 0) && ok;
+		}
+		else if (key == "obstacle_lod") {
+			ok = parseValue(key, value, options.obstacleLod, -1) && ok;
+			if (options.obstacleLod >= MESH_LOD_LEVELS) {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+		}
+		else if (key == "points") {
+			options.pointsPath = value;
+		}
+		else if (key == "points_budget") {
+			ok = parseValue(key, value, options.pointsBudget, 0.0f) && ok;
+		}
+		else if (key == "capsule") {
+			// x0,y0,z0,x1,y1,z1,radius
+			vector<float> v;
+			if (!parseList(key, value, v, 7)) {
+				ok = false;
+			}
+			else if (!(v[6] > 0.0f)) {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+			else {
+				options.capsules.push_back(CapsuleShape(vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), v[6]));
+			}
+		}
+		else if (key == "box") {
+			// x,y,z,half x,half y,half z[,degrees around y]
+			vector<float> v;
+			if (!parseList(key, value, v, 7, true)) {
+				ok = false;
+			}
+			else if (!(v[3] > 0.0f && v[4] > 0.0f && v[5] > 0.0f)) {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+			else {
+				float angle = v.size() > 6 ? glm::radians(v[6]) : 0.0f;
+				mat3 axes(glm::rotate(mat4(1.0f), angle, vec3(0.0f, 1.0f, 0.0f)));
+				options.boxes.push_back(BoxShape(vec3(v[0], v[1], v[2]), axes, vec3(v[3], v[4], v[5])));
+			}
+		}
+		else if (key == "max_steps" || key == "step_budget_ms" || key == "time_dilation") {
+			stringstream in(value);
+			float budgetMs = 0.0f;
+			bool valid = key == "max_steps" ? (bool)(in >> options.budget.maxSteps) :
+				key == "step_budget_ms" ? (bool)(in >> budgetMs) : (bool)(in >> options.budget.timeDilation);
+			if (key == "step_budget_ms") {
+				options.budget.maxSeconds = budgetMs / 1000.0f;
+			}
+			if (!valid) {
+				cout << "ERROR: BAD VALUE FOR OPTION " << key << "!" << endl;
+				ok = false;
+			}
+		}
+		else {
+			ok = parseSceneArg(key, value, scene) && ok;
+		}
+	}
+	return ok;
+}
+
 // ʱ
 float deltaTime = 0.0f;	// ֮֡ʱ
 float lastFrame = 0.0f; // һ֡
 
 
-int main()
+int main(int argc, char** argv)
 {
+	// scene description from --scene=<file> and --<key>=<value> options
+	SceneSpec scene;
+	if (!parseArgs(argc, argv, scene)) {
+		return -1;
+	}
+
 	// glfw ʼ
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	bool headless = !options.headlessDir.empty();
+	if (headless) {
+		// the window only provides the context, everything is drawn into an fbo
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+	if (options.context == "egl") {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
+	else if (options.context == "osmesa") {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	}
 
 	// glfw ڴ
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Collision Detection", NULL, NULL);
+	if (window == NULL) {
+		cout << "ERROR: UNABLE TO CREATE A " << options.context << " GL CONTEXT!" << endl;
+		glfwTerminate();
+		return -1;
+	}
 	glfwMakeContextCurrent(window);
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	glfwSetKeyCallback(window, key_callback);
 	if (MOVABLE_CAM) {
 		// ص
 		glfwSetCursorPosCallback(window, mouse_callback);
@@ -62,7 +368,9 @@ int main()
 	}
 
 	// ׽
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless) {
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
 	
 	// gladOpenGL
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -76,35 +384,129 @@ int main()
 
 	// ɫ
 	Shader shader("resources/shader/vertex.vs", "resources/shader/frag.fs");
+	Shader ballShader("resources/shader/ball.vs", "resources/shader/ball.fs");
+	Shader impostorShader("resources/shader/impostor.vs", "resources/shader/impostor.fs");
+	Shader pointShader("resources/shader/point.vs", "resources/shader/point.fs");
+
+	// the camera and the light are shared by all the programs through uniform buffers
+	UniformBuffer<CameraBlock> cameraBuffer;
+	UniformBuffer<LightBlock> lightBuffer;
+	cameraBuffer.init(CAMERA_BLOCK);
+	lightBuffer.init(LIGHT_BLOCK);
+	Shader* programs[4] = { &shader, &ballShader, &impostorShader, &pointShader };
+	for (Shader* s : programs) {
+		s->bindBlock("Camera", CAMERA_BLOCK);
+		s->bindBlock("Light", LIGHT_BLOCK);
+	}
 
 	// 
-	detector.generateBalls(NUM_BALLS);
+	if (headless) {
+		// frames are not drawn in real time, so every step is taken
+		options.budget.maxSteps = 0;
+		options.budget.maxSeconds = 0.0f;
+		options.budget.timeDilation = false;
+	}
+	detector.setStepBudget(options.budget);
+	if (options.restorePath.empty() || !detector.loadCheckpoint(options.restorePath.c_str())) {
+		detector.generateBalls(scene);
+	}
+	// the models stand on the middle of the floor
+	for (auto& path : options.obstaclePaths) {
+		detector.addObstacle(path.c_str(), glm::vec3(0.0f, MIN_POS.y, 0.0f), options.obstacleSize, options.obstacleField, options.obstacleLod, options.obstacleFieldChecks);
+	}
+	for (auto& capsule : options.capsules) {
+		detector.addPart(capsule);
+	}
+	for (auto& box : options.boxes) {
+		detector.addPart(box);
+	}
+	if (!options.recordPath.empty() && recorder.open(options.recordPath.c_str(), detector.getBalls())) {
+		detector.setRecorder(&recorder);
+	}
+
+	// a replay is decoded on the render thread into a snapshot of its own
+	BallSnapshot replaySnapshot;
+	float replayTime = 0.0f;
+	replaying = !options.replayPath.empty() && replay.open(options.replayPath.c_str());
+	if (replaying) {
+		replaySnapshot.radius.assign(replay.radii(), replay.radii() + replay.numBalls());
+		replaySnapshot.color.assign(replay.colors(), replay.colors() + replay.numBalls());
+		replaySnapshot.pos.assign(replay.numBalls(), vec3(0.0f));
+		replay.next(replaySnapshot.pos);
+		replaySnapshot.prevPos = replaySnapshot.pos;
+	}
+	else if (!headless) {
+		detector.fillSnapshot(snapshots.writeBuffer());
+		snapshots.writeBuffer().time = wallTime();
+		snapshots.publish();
+		simulating = true;
+	}
+	// without a display the simulation runs on this thread, one frame of simulated time per frame
+	BallSnapshot headlessSnapshot;
+	detector.fillSnapshot(headlessSnapshot);
+
+	// the render target and readback of headless frames
+	OffscreenTarget target;
+	FrameCapture capture;
+	int capturedFrames = 0;
+	int renderWidth = headless ? options.width : SCR_WIDTH;
+	int renderHeight = headless ? options.height : SCR_HEIGHT;
+	if (headless) {
+		if (!target.init(renderWidth, renderHeight)) {
+			glfwTerminate();
+			return -1;
+		}
+		capture.init(renderWidth, renderHeight, options.headlessDir + "/frame_%06d.ppm");
+	}
+	// the parts are meshed before the simulation starts, it rewrites the spheres of the balls
+	// kept in the same shape set every step
+	vector<Mesh> partMeshes(detector.getParts().size());
+	for (size_t i = 0; i < partMeshes.size(); i++) {
+		shapeMesh(detector.getShapes(), detector.getParts()[i], partMeshes[i]);
+	}
+	thread simulation;
+	if (simulating) {
+		simulation = thread(simulate);
+	}
 
 	// 
 	Sphere sphere;
-	sphere.buildSphere();
-	sphere.generateIndices();
-
-	unsigned int ballVBO;
-	unsigned int ballVAO;
-
-	glGenVertexArrays(1, &ballVAO);
-	glGenBuffers(1, &ballVBO);
-	glBindVertexArray(ballVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
-	glBufferData(GL_ARRAY_BUFFER, sphere.vertices.size() * sizeof(float), &sphere.vertices[0], GL_STATIC_DRAW);
-
-	unsigned int ballEBO;
-	glGenBuffers(1, &ballEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ballEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere.indices.size() * sizeof(int), &sphere.indices[0], GL_STATIC_DRAW);
-	
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	sphere.buildLods();
+
+	BallRenderer ballRenderer;
+	ballRenderer.init(sphere, (GLADloadproc)glfwGetProcAddress);
+
+	// the meshes do not move, so they are read while the simulation runs
+	// every level of detail of an obstacle gets a renderer
+	vector<MeshRenderer> obstacleRenderers(detector.getObstacles().size() * MESH_LOD_LEVELS);
+	for (size_t i = 0; i < obstacleRenderers.size(); i++) {
+		obstacleRenderers[i].init(detector.getObstacles()[i / MESH_LOD_LEVELS]->getLod(i % MESH_LOD_LEVELS));
+	}
+
+	// the parts are drawn as meshes already in world space
+	vector<MeshRenderer> partRenderers(partMeshes.size());
+	for (size_t i = 0; i < partRenderers.size(); i++) {
+		Bvh bvh;
+		MeshView view;
+		view.adopt(partMeshes[i], bvh);
+		partRenderers[i].init(view);
+	}
+
+	// a scan stands on the floor like an obstacle, but only the part the camera needs is in memory
+	PointCloud pointCloud;
+	PointCloudRenderer pointRenderer;
+	glm::vec3 pointOffset(0.0f);
+	float pointScale = 1.0f;
+	size_t pointBudget = (size_t)(options.pointsBudget * 1024.0f * 1024.0f);
+	if (!options.pointsPath.empty() && pointCloud.open(options.pointsPath.c_str())) {
+		glm::vec3 lo, hi;
+		pointCloud.bounds(lo, hi);
+		glm::vec3 extent = hi - lo;
+		float side = std::max(extent.x, std::max(extent.y, extent.z));
+		pointScale = side > 0.0f ? options.obstacleSize / side : 1.0f;
+		pointOffset = glm::vec3(0.0f, MIN_POS.y, 0.0f) - glm::vec3((lo.x + hi.x) * 0.5f, lo.y, (lo.z + hi.z) * 0.5f) * pointScale;
+	}
+	glm::mat4 pointModel = glm::scale(glm::translate(glm::mat4(1.0f), pointOffset), glm::vec3(pointScale));
 	
 	// ÷䣨Լƽ棩
 	unsigned int planeVBO;
@@ -128,7 +530,6 @@ int main()
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 	
-	float dt = 0.0f;
 	// Ⱦѭ
 	while (!glfwWindowShouldClose(window))
 	{
@@ -136,13 +537,57 @@ int main()
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		if (headless) {
+			deltaTime = 1.0f / options.fps;
+		}
 
 		// С
-		detector.update(deltaTime, dt);
+		if (replaying) {
+			// one recorded frame per simulation step, looping at the end,
+			// after a jump or a wrap the previous frame is reset so nothing sweeps across the box
+			if (replayJumped) {
+				replayJumped = false;
+				replayTime = 0.0f;
+				replay.next(replaySnapshot.pos);
+				replaySnapshot.prevPos = replaySnapshot.pos;
+			}
+			replayTime += deltaTime;
+			while (replayTime >= UPDATE_INTERVAL) {
+				replayTime -= UPDATE_INTERVAL;
+				replaySnapshot.prevPos.swap(replaySnapshot.pos);
+				if (!replay.next(replaySnapshot.pos)) {
+					if (!replay.seek(0) || !replay.next(replaySnapshot.pos)) {
+						break;
+					}
+					replaySnapshot.prevPos = replaySnapshot.pos;
+				}
+			}
+			replaySnapshot.alpha = replayTime / UPDATE_INTERVAL;
+			replaySnapshot.time = wallTime();
+		}
+		else if (headless) {
+			simulateStep(deltaTime, headlessSnapshot);
+		}
+		else {
+			snapshots.update();
+		}
+		const BallSnapshot& frame = replaying ? replaySnapshot : headless ? headlessSnapshot : snapshots.readBuffer();
+
+		// draw between the last two fixed steps, advanced by the simulated time since the snapshot
+		// was taken unless frames are not drawn in real time, which runs slower while time is dilated
+		float alpha = frame.alpha;
+		if (!headless) {
+			alpha = glm::clamp(frame.alpha + (float)(wallTime() - frame.time) * frame.timeScale / UPDATE_INTERVAL, 0.0f, 1.0f);
+		}
 
 		// ӽ
-		glm::mat4 projection = glm::perspective(glm::radians(camera.getZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.getZoom()), (float)renderWidth / (float)renderHeight, 0.1f, 100.0f);
 		glm::mat4 view = camera.getViewMatrix();
+		if (options.cull) {
+			lock_guard<mutex> lock(cullMutex);
+			cullFrustum = extractFrustum(projection * view);
+			cullReady = true;
+		}
 
 		// ͼ
 		processInput(window);
@@ -155,41 +600,33 @@ int main()
 		glCullFace(GL_BACK);
 
 		// ɫ
-		shader.use();
-		shader.setVec3("viewPos", camera._pos);
-		shader.setMat4("projection", projection);
-		shader.setMat4("view", view);
 		glm::vec3 lightDir = glm::vec3(1.0f, -1.0f, 0.0f);
 		glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
 		glm::vec3 diffuseColor = lightColor * glm::vec3(0.8f);
 		glm::vec3 ambientColor = diffuseColor * glm::vec3(0.2f);
-		shader.setVec3("light.ambient", ambientColor);
-		shader.setVec3("light.diffuse", diffuseColor);
-		shader.setVec3("light.direction", lightDir);
-		shader.setVec3("light.specular", lightColor);
+		ballRenderer.setMode(options.renderMode);
+		Shader& ballProgram = options.renderMode == RENDER_IMPOSTOR ? impostorShader : ballShader;
+		CameraBlock cameraBlock = { view, projection, glm::vec4(camera._pos, 1.0f) };
+		cameraBuffer.update(cameraBlock);
+		LightBlock lightBlock = { glm::vec4(lightDir, 0.0f), glm::vec4(ambientColor, 1.0f),
+			glm::vec4(diffuseColor, 1.0f), glm::vec4(lightColor, 1.0f) };
+		lightBuffer.update(lightBlock);
 
 		// 
-		for (auto b : detector.getBalls()) {
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, b->pos);
-			model = glm::scale(model, glm::vec3(b->radius));
-			shader.setMat4("model", model);
-			shader.setVec3("material.ambient", b->color);
-			shader.setVec3("material.diffuse", b->color);
-			shader.setFloat("material.shininess", 32.0f);
-			shader.setVec3("material.specular", b->color * 0.6f); 
-			glBindVertexArray(ballVAO);
-			glPointSize(2);
-			glDrawElements(GL_TRIANGLES, sizeof(int) * sphere.indices.size(), GL_UNSIGNED_INT, 0);
-		}
+		ballProgram.use();
+		ballProgram.setFloat(SHININESS_UNIFORM, 32.0f);
+		ballRenderer.update(frame, alpha, view, projection, (float)renderHeight);
+		ballRenderer.draw();
 		
 
 		// Ʒ
+		shader.use();
 		const glm::vec3 PLANE_COLOR = vec3(0.2f, 0.2f, 0.3f);
-		shader.setVec3("material.ambient", PLANE_COLOR);
-		shader.setVec3("material.diffuse", PLANE_COLOR);
-		shader.setFloat("material.shininess", 32.0f);
-		shader.setVec3("material.specular", PLANE_COLOR * 0.6f);
+		const glm::vec3 OBSTACLE_COLOR = vec3(0.7f, 0.6f, 0.45f);
+		shader.setVec3(MATERIAL_AMBIENT_UNIFORM, PLANE_COLOR);
+		shader.setVec3(MATERIAL_DIFFUSE_UNIFORM, PLANE_COLOR);
+		shader.setFloat(MATERIAL_SHININESS_UNIFORM, 32.0f);
+		shader.setVec3(MATERIAL_SPECULAR_UNIFORM, PLANE_COLOR * 0.6f);
 		const glm::mat4 floorTrans = glm::scale(
 			glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, MIN_POS.y, 0.0f)),
 			glm::vec3(SIZE)
@@ -212,30 +649,85 @@ int main()
 			glm::vec3(SIZE)
 		);
 
-		shader.setMat4("model", floorTrans);
+		shader.setMat4(MODEL_UNIFORM, floorTrans);
 		glBindVertexArray(planeVAO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-		shader.setMat4("model", leftTrans);
+		shader.setMat4(MODEL_UNIFORM, leftTrans);
 		glBindVertexArray(planeVAO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-		shader.setMat4("model", rightTrans);
+		shader.setMat4(MODEL_UNIFORM, rightTrans);
 		glBindVertexArray(planeVAO);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+		// ϰ
+		shader.setVec3(MATERIAL_AMBIENT_UNIFORM, OBSTACLE_COLOR);
+		shader.setVec3(MATERIAL_DIFFUSE_UNIFORM, OBSTACLE_COLOR);
+		shader.setVec3(MATERIAL_SPECULAR_UNIFORM, OBSTACLE_COLOR * 0.6f);
+		for (size_t i = 0; i < detector.getObstacles().size(); i++) {
+			const Obstacle* obstacle = detector.getObstacles()[i];
+			shader.setMat4(MODEL_UNIFORM, obstacle->modelMatrix());
+			obstacleRenderers[i * MESH_LOD_LEVELS + obstacle->lodLevel(camera._pos)].draw();
+		}
+		shader.setMat4(MODEL_UNIFORM, glm::mat4(1.0f));
+		for (auto& r : partRenderers) {
+			r.draw();
+		}
+
+		// load what the camera now sees, as far as the budget allows, and draw what is loaded
+		if (pointCloud.numNodes() > 0) {
+			pointCloud.update((camera._pos - pointOffset) / pointScale, pointBudget);
+			pointShader.use();
+			pointShader.setMat4(MODEL_UNIFORM, pointModel);
+			pointShader.setVec3(COLOR_UNIFORM, OBSTACLE_COLOR);
+			pointRenderer.draw(pointCloud);
+		}
 		
 		// 
-		glfwSwapBuffers(window);
+		if (headless) {
+			capture.capture(capturedFrames++);
+			if (capturedFrames >= options.frames) {
+				glfwSetWindowShouldClose(window, true);
+			}
+		}
+		else {
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
 	}
 	
 	// ڴ
-	glDeleteVertexArrays(1, &ballVAO);
-	glDeleteBuffers(1, &ballVBO);
-	glDeleteBuffers(1, &ballEBO);
+	if (headless) {
+		bool written = capture.finish();
+		cout << capturedFrames << " frames " << (written ? "written to " : "NOT all written to ") << options.headlessDir << endl;
+		capture.release();
+		target.release();
+	}
+	ballRenderer.release();
+	for (auto& r : obstacleRenderers) {
+		r.release();
+	}
+	pointRenderer.release();
+	for (auto& r : partRenderers) {
+		r.release();
+	}
+	cameraBuffer.release();
+	lightBuffer.release();
 	glDeleteVertexArrays(1, &planeVAO);
 	glDeleteBuffers(1, &planeVBO);
 	glDeleteBuffers(1, &planeEBO);
+	simulating = false;
+	if (simulation.joinable()) {
+		simulation.join();
+	}
+	detector.setRecorder(nullptr);
+	recorder.close();
+	const StepBudgetStats& budgetStats = detector.getStepBudgetStats();
+	if (budgetStats.overBudgetUpdates > 0) {
+		cout << "simulation fell behind " << budgetStats.overBudgetUpdates << " times, dropped "
+			<< budgetStats.droppedTime << "s and dilated " << budgetStats.dilatedTime << "s of simulated time" << endl;
+	}
 	glfwTerminate();
 	return 0;
 }
@@ -258,9 +750,33 @@ void processInput(GLFWwindow *window)
 	}
 }
 
+// one-shot key actions
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	(void)window;
+	(void)scancode;
+	(void)mods;
+
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+		checkpointRequested = true;
+
+	// switch between the sphere mesh and ray-cast impostors
+	if (key == GLFW_KEY_TAB && action == GLFW_PRESS)
+		options.renderMode = options.renderMode == RENDER_IMPOSTOR ? RENDER_MESH : RENDER_IMPOSTOR;
+
+	// jump one second through a replay
+	const long long REPLAY_JUMP = (long long)(1.0f / UPDATE_INTERVAL);
+	if (replaying && key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
+		replayJumped = replay.seek(std::min((long long)replay.currentFrame() + REPLAY_JUMP, (long long)replay.frameCount() - 1)) || replayJumped;
+	if (replaying && key == GLFW_KEY_LEFT && action == GLFW_PRESS)
+		replayJumped = replay.seek(std::max((long long)replay.currentFrame() - REPLAY_JUMP, 0LL)) || replayJumped;
+}
+
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+	(void)window;
+
 	// make sure the viewport matches the new window dimensions; note that width and 
 	// height will be significantly larger than specified on retina displays.
 	glViewport(0, 0, width, height);
@@ -270,6 +786,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // ƶ¼
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	(void)window;
+
 	if (firstMouse)
 	{
 		lastX = xpos;
@@ -289,5 +807,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 // ¼
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	(void)window;
+	(void)xoffset;
+
 	camera.processMouseScroll(yoffset);
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+// a class to map a whole file read-only into memory
+// the pages are loaded by the os on first access, so opening is cheap
+// regardless of the file size
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+private:
+	const char* data;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+public:
+	MappedFile() : data(nullptr), length(0)
+#ifdef _WIN32
+		, file(INVALID_HANDLE_VALUE), mapping(NULL)
+#else
+		, fd(-1)
+#endif
+	{
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+		length = (size_t)fileSize.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close();
+			return false;
+		}
+		length = (size_t)st.st_size;
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		data = p == MAP_FAILED ? nullptr : (const char*)p;
+#endif
+		if (data == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (data != nullptr) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr) {
+			munmap((void*)data, length);
+		}
+		if (fd >= 0) {
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		data = nullptr;
+		length = 0;
+	}
+
+	bool isOpen() const {
+		return data != nullptr;
+	}
+
+	const char* begin() const {
+		return data;
+	}
+
+	const char* end() const {
+		return data + length;
+	}
+
+	size_t size() const {
+		return length;
+	}
+};
+
+#endif
@@ -0,0 +1,113 @@
+// a triangle mesh kept as separate arrays of coordinates (SoA), so loops over one
+// coordinate of many vertices read contiguous memory
+// vertices may carry extra scalar properties, e.g. the confidence and intensity of scans
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+struct MeshProperty {
+	string name;
+	vector<float> values; // one per vertex
+};
+
+struct Mesh {
+	vector<float> x;
+	vector<float> y;
+	vector<float> z;
+	vector<float> nx; // vertex normals, empty until computeNormals
+	vector<float> ny;
+	vector<float> nz;
+	vector<uint32_t> indices; // three per triangle, counter-clockwise
+	vector<MeshProperty> properties;
+
+	size_t numVertices() const {
+		return x.size();
+	}
+
+	size_t numTriangles() const {
+		return indices.size() / 3;
+	}
+
+	vec3 vertex(size_t i) const {
+		return vec3(x[i], y[i], z[i]);
+	}
+
+	vec3 normal(size_t i) const {
+		return vec3(nx[i], ny[i], nz[i]);
+	}
+
+	void resizeVertices(size_t n) {
+		x.resize(n);
+		y.resize(n);
+		z.resize(n);
+		for (auto& p : properties) {
+			p.values.resize(n);
+		}
+	}
+
+	// null if the vertices have no such property
+	const MeshProperty* property(const string& name) const {
+		for (auto& p : properties) {
+			if (p.name == name) {
+				return &p;
+			}
+		}
+		return nullptr;
+	}
+
+	// the axis-aligned box around all the vertices, empty (min > max) without vertices
+	void bounds(vec3& minPos, vec3& maxPos) const {
+		minPos = vec3(INFINITY);
+		maxPos = vec3(-INFINITY);
+		for (size_t i = 0; i < x.size(); i++) {
+			minPos = glm::min(minPos, vertex(i));
+			maxPos = glm::max(maxPos, vertex(i));
+		}
+	}
+
+	// vertex normals as the area weighted average of the normals of the triangles around them
+	void computeNormals() {
+		vector<vec3> sum(numVertices(), vec3(0.0f));
+		for (size_t t = 0; t < numTriangles(); t++) {
+			uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+			// twice the area times the unit normal
+			vec3 n = cross(vertex(b) - vertex(a), vertex(c) - vertex(a));
+			sum[a] += n;
+			sum[b] += n;
+			sum[c] += n;
+		}
+		nx.resize(sum.size());
+		ny.resize(sum.size());
+		nz.resize(sum.size());
+		for (size_t i = 0; i < sum.size(); i++) {
+			float len = length(sum[i]);
+			vec3 n = len > 0.0f ? sum[i] / len : vec3(0.0f, 1.0f, 0.0f);
+			nx[i] = n.x;
+			ny[i] = n.y;
+			nz[i] = n.z;
+		}
+	}
+
+	void clear() {
+		x.clear();
+		y.clear();
+		z.clear();
+		nx.clear();
+		ny.clear();
+		nz.clear();
+		indices.clear();
+		properties.clear();
+	}
+};
+
+#endif
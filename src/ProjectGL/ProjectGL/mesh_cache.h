@@ -0,0 +1,326 @@
+// a binary cache of a loaded mesh, so a model is parsed once and mapped afterwards
+// the cache sits next to the source file and holds a fixed header followed by
+// page-aligned arrays: the vertex coordinates and normals (SoA), the indices and the bvh
+// it is used only while its header matches the size, modification time and a hash of
+// samples of the source, otherwise the source is parsed again and the cache rewritten
+// extra vertex properties are not cached
+// the mesh is reordered by mesh_optimize.h before it is cached, so the arrays are stored
+// in the order they are drawn
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh.h"
+#include "bvh.h"
+#include "mesh_optimize.h"
+#include "ply.h"
+#include "mapped_file.h"
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+const char MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+const uint32_t MESH_CACHE_VERSION = 3; // raise when the layout, the bvh builder, the reordering or the simplifier changes
+const uint32_t MESH_CACHE_ENDIAN_TAG = 0x01020304u;
+const size_t MESH_CACHE_ALIGNMENT = 4096;
+const char MESH_CACHE_SUFFIX[] = ".mcache";
+const bool MESH_SORT_FOR_OVERDRAW = true; // sort the triangle clusters of cached meshes from the outside in
+
+// bytes of the source hashed: the start, the end and this many blocks in between
+const size_t MESH_SAMPLE_SIZE = 64 * 1024;
+const int MESH_SAMPLE_BLOCKS = 16;
+
+enum MeshSection {
+	MESH_X, MESH_Y, MESH_Z, MESH_NX, MESH_NY, MESH_NZ, MESH_INDICES, MESH_NODES, MESH_TRIANGLES, NUM_MESH_SECTIONS
+};
+
+// what the cache was made from
+struct MeshSource {
+	uint64_t size;
+	int64_t time; // modification time in seconds
+	uint64_t hash; // 64 bit FNV-1a of the sampled bytes
+};
+
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t endianTag;
+	MeshSource source;
+	uint64_t numVertices;
+	uint64_t numTriangles;
+	uint64_t numNodes;
+	uint64_t offsets[NUM_MESH_SECTIONS]; // from the start of the file
+	uint64_t fileSize;
+};
+
+inline size_t alignMeshCache(size_t offset) {
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+inline size_t meshSectionSize(int section, uint64_t numVertices, uint64_t numTriangles, uint64_t numNodes) {
+	if (section <= MESH_NZ) return (size_t)numVertices * sizeof(float);
+	if (section == MESH_INDICES) return (size_t)numTriangles * 3 * sizeof(uint32_t);
+	if (section == MESH_NODES) return (size_t)numNodes * sizeof(BvhNode);
+	return (size_t)numTriangles * sizeof(uint32_t);
+}
+
+inline uint64_t hashBytes(const char* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// describe a source file, reading only samples of it so large files stay cheap
+inline bool describeMeshSource(const char* path, MeshSource& source) {
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path, &st) != 0) {
+		return false;
+	}
+#else
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		return false;
+	}
+#endif
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	source.size = file.size();
+	source.time = (int64_t)st.st_mtime;
+	size_t sample = std::min(MESH_SAMPLE_SIZE, file.size());
+	uint64_t hash = hashBytes(file.begin(), sample);
+	for (int b = 1; b <= MESH_SAMPLE_BLOCKS; b++) {
+		size_t offset = (file.size() - sample) / (MESH_SAMPLE_BLOCKS + 1) * b;
+		hash = hashBytes(file.begin() + offset, std::min((size_t)4096, sample), hash);
+	}
+	source.hash = hashBytes(file.end() - sample, sample, hash);
+	return true;
+}
+
+// lay out a mesh with normals and its bvh as the cache file stores them
+inline void buildMeshCacheImage(const Mesh& mesh, const Bvh& bvh, const MeshSource& source, vector<char>& image) {
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.endianTag = MESH_CACHE_ENDIAN_TAG;
+	header.source = source;
+	header.numVertices = mesh.numVertices();
+	header.numTriangles = mesh.numTriangles();
+	header.numNodes = bvh.nodes.size();
+
+	size_t offset = alignMeshCache(sizeof(header));
+	for (int s = 0; s < NUM_MESH_SECTIONS; s++) {
+		header.offsets[s] = offset;
+		offset = alignMeshCache(offset + meshSectionSize(s, header.numVertices, header.numTriangles, header.numNodes));
+	}
+	header.fileSize = offset;
+
+	image.assign(offset, 0);
+	memcpy(image.data(), &header, sizeof(header));
+	const void* sections[NUM_MESH_SECTIONS] = {
+		mesh.x.data(), mesh.y.data(), mesh.z.data(), mesh.nx.data(), mesh.ny.data(), mesh.nz.data(),
+		mesh.indices.data(), bvh.nodes.data(), bvh.triangles.data()
+	};
+	for (int s = 0; s < NUM_MESH_SECTIONS; s++) {
+		size_t size = meshSectionSize(s, header.numVertices, header.numTriangles, header.numNodes);
+		if (size > 0) {
+			memcpy(image.data() + header.offsets[s], sections[s], size);
+		}
+	}
+}
+
+// write to a temporary file first so a crash never leaves a truncated cache behind
+inline bool writeMeshCacheImage(const string& path, const vector<char>& image) {
+	string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		remove(tmpPath.c_str());
+		return false;
+	}
+	// rename does not replace an existing file on windows
+	remove(path.c_str());
+	return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// a mesh with normals and bvh, mapped from its cache, or held in memory when the
+// cache could not be written
+class MeshView {
+private:
+	MappedFile file;
+	Mesh ownedMesh;
+	Bvh ownedBvh;
+	const float* coords[6]; // x, y, z, nx, ny, nz
+	const uint32_t* indexData;
+	const BvhNode* nodeData;
+	const uint32_t* triangleData;
+	size_t vertexCount;
+	size_t triangleCount;
+	size_t nodeCount;
+
+	void reset() {
+		file.close();
+		ownedMesh.clear();
+		ownedBvh.nodes.clear();
+		ownedBvh.triangles.clear();
+		for (int i = 0; i < 6; i++) {
+			coords[i] = nullptr;
+		}
+		indexData = nullptr;
+		nodeData = nullptr;
+		triangleData = nullptr;
+		vertexCount = triangleCount = nodeCount = 0;
+	}
+
+public:
+	MeshView() {
+		reset();
+	}
+
+	MeshView(const MeshView&) = delete;
+	MeshView& operator=(const MeshView&) = delete;
+
+	// map a cache, return false if it is missing, corrupt or not made from source
+	bool openCache(const char* path, const MeshSource& source) {
+		reset();
+		if (!file.open(path)) {
+			return false;
+		}
+		const MeshCacheHeader* h = (const MeshCacheHeader*)file.begin();
+		bool valid = file.size() >= sizeof(MeshCacheHeader) &&
+			memcmp(h->magic, MESH_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+			h->version == MESH_CACHE_VERSION &&
+			h->endianTag == MESH_CACHE_ENDIAN_TAG &&
+			h->fileSize == file.size() &&
+			h->source.size == source.size &&
+			h->source.time == source.time &&
+			h->source.hash == source.hash &&
+			h->numVertices < UINT32_MAX && h->numTriangles < UINT32_MAX && h->numNodes < UINT32_MAX;
+		// subtract rather than add, a huge offset in a bad file would wrap the sum
+		for (int s = 0; valid && s < NUM_MESH_SECTIONS; s++) {
+			valid = h->offsets[s] % MESH_CACHE_ALIGNMENT == 0 &&
+				h->offsets[s] <= file.size() &&
+				meshSectionSize(s, h->numVertices, h->numTriangles, h->numNodes) <= file.size() - h->offsets[s];
+		}
+		if (!valid) {
+			file.close();
+			return false;
+		}
+		for (int i = 0; i < 6; i++) {
+			coords[i] = (const float*)(file.begin() + h->offsets[MESH_X + i]);
+		}
+		indexData = (const uint32_t*)(file.begin() + h->offsets[MESH_INDICES]);
+		nodeData = (const BvhNode*)(file.begin() + h->offsets[MESH_NODES]);
+		triangleData = (const uint32_t*)(file.begin() + h->offsets[MESH_TRIANGLES]);
+		vertexCount = (size_t)h->numVertices;
+		triangleCount = (size_t)h->numTriangles;
+		nodeCount = (size_t)h->numNodes;
+		// the source checks only say the cache was made from the model, a damaged cache of the
+		// right size would still be trusted, so the indices are checked before they are used
+		for (size_t i = 0; valid && i < triangleCount * 3; i++) {
+			valid = indexData[i] < vertexCount;
+		}
+		if (!valid || !isValidBvh(nodeData, nodeCount, triangleData, triangleCount)) {
+			reset();
+			return false;
+		}
+		return true;
+	}
+
+	// take over a mesh with normals and its bvh
+	void adopt(Mesh& mesh, Bvh& bvh) {
+		reset();
+		swap(ownedMesh, mesh);
+		swap(ownedBvh.nodes, bvh.nodes);
+		swap(ownedBvh.triangles, bvh.triangles);
+		const vector<float>* arrays[6] = { &ownedMesh.x, &ownedMesh.y, &ownedMesh.z, &ownedMesh.nx, &ownedMesh.ny, &ownedMesh.nz };
+		for (int i = 0; i < 6; i++) {
+			coords[i] = arrays[i]->data();
+		}
+		indexData = ownedMesh.indices.data();
+		nodeData = ownedBvh.nodes.data();
+		triangleData = ownedBvh.triangles.data();
+		vertexCount = ownedMesh.numVertices();
+		triangleCount = ownedMesh.numTriangles();
+		nodeCount = ownedBvh.nodes.size();
+	}
+
+	bool isMapped() const {
+		return file.isOpen();
+	}
+
+	size_t numVertices() const { return vertexCount; }
+	size_t numTriangles() const { return triangleCount; }
+	size_t numNodes() const { return nodeCount; }
+
+	const float* x() const { return coords[0]; }
+	const float* y() const { return coords[1]; }
+	const float* z() const { return coords[2]; }
+	const float* nx() const { return coords[3]; }
+	const float* ny() const { return coords[4]; }
+	const float* nz() const { return coords[5]; }
+	const uint32_t* indices() const { return indexData; }
+	const BvhNode* nodes() const { return nodeData; }
+	const uint32_t* bvhTriangles() const { return triangleData; }
+
+	vec3 vertex(size_t i) const {
+		return vec3(coords[0][i], coords[1][i], coords[2][i]);
+	}
+
+	vec3 normal(size_t i) const {
+		return vec3(coords[3][i], coords[4][i], coords[5][i]);
+	}
+};
+
+// reorder a mesh with normals, build its bvh and write its cache, then map the cache, or
+// keep the mesh in memory if the cache cannot be written
+inline void cacheMesh(Mesh& mesh, const MeshSource& source, const string& cachePath, MeshView& view) {
+	optimizeMesh(mesh, MESH_SORT_FOR_OVERDRAW);
+	Bvh bvh;
+	bvh.build(mesh);
+	vector<char> image;
+	buildMeshCacheImage(mesh, bvh, source, image);
+	if (writeMeshCacheImage(cachePath, image) && view.openCache(cachePath.c_str(), source)) {
+		return;
+	}
+	cout << "WARNING: MESH CACHE " << cachePath << " UNABLE TO WRITE" << endl;
+	view.adopt(mesh, bvh);
+}
+
+// load a PLY model through its cache, building and writing the cache when it is stale
+inline bool loadMesh(const char* path, MeshView& view) {
+	MeshSource source;
+	if (!describeMeshSource(path, source)) {
+		cout << "ERROR: MESH " << path << " UNABLE TO LOAD!" << endl;
+		return false;
+	}
+	string cachePath = string(path) + MESH_CACHE_SUFFIX;
+	if (view.openCache(cachePath.c_str(), source)) {
+		return true;
+	}
+
+	Mesh mesh;
+	if (!loadPly(path, mesh)) {
+		return false;
+	}
+	mesh.computeNormals();
+	cacheMesh(mesh, source, cachePath, view);
+	return true;
+}
+
+#endif
@@ -0,0 +1,322 @@
+// intersection of two rigid triangle meshes by descending both bvhs at once
+// the second mesh is mapped into the space of the first, and each of its boxes is replaced
+// by the box around the mapped one, so the hierarchies are never rebuilt when a mesh moves
+// the node pairs the descent stopped at, apart or both leaves, make up the front, and the
+// next call starts from the front instead of the roots, so when the meshes move a little
+// between frames the boxes near the contact are all that is tested again
+// before that, sibling pairs are merged back into the pair of their parent when all three
+// are apart, so the front shrinks again as the meshes separate instead of keeping every
+// split it ever made
+// in a pair of leaves the triangles of the second are first tested against the plane of
+// each triangle of the first four at a time with sse, the ones left go through the exact
+// test in triangle.h
+// reference: Gino van den Bergen, "Efficient Collision Detection of Complex Deformable Models using AABB Trees", 1997
+
+#ifndef MESH_COLLIDE_H
+#define MESH_COLLIDE_H
+
+#include "mesh_cache.h"
+#include "triangle.h"
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <emmintrin.h>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const size_t MESH_COLLIDE_PARALLEL_PAIRS = 256; // smaller fronts are descended by one thread
+const size_t MESH_COLLIDE_FRONT_GROWTH = 4; // a front this many times the one from the roots is dropped
+
+// where a mesh is in the world, a point p of the model is at position + rotation * (scale * p)
+struct MeshPose {
+	mat3 rotation;
+	vec3 position;
+	float scale;
+
+	MeshPose() : rotation(1.0f), position(0.0f), scale(1.0f) {}
+	MeshPose(const mat3& rotation, const vec3& position, float scale) : rotation(rotation), position(position), scale(scale) {}
+};
+
+// two intersecting triangles, indices into the triangles of each mesh
+struct MeshTrianglePair {
+	uint32_t a;
+	uint32_t b;
+};
+
+class MeshCollider {
+private:
+	struct NodePair {
+		uint32_t a;
+		uint32_t b;
+	};
+
+	// what one thread collects while descending part of the front
+	struct Work {
+		vector<NodePair> stack;
+		vector<NodePair> front;
+		vector<MeshTrianglePair> pairs;
+	};
+
+	const MeshView* meshA;
+	const MeshView* meshB;
+	vector<uint32_t> parentsA; // of every node, the root is its own parent
+	vector<uint32_t> parentsB;
+	vector<NodePair> front;
+	vector<char> frontApart; // whether each pair of the front was found apart by coarsening it
+	size_t rootFrontSize; // of the front left by the last descent from the roots
+	mat3 toA; // from the model space of b to that of a
+	mat3 absToA;
+	vec3 shift;
+
+	// the box around node b mapped into the space of a
+	void mappedBox(const BvhNode& node, vec3& minPos, vec3& maxPos) const {
+		vec3 center = toA * ((node.minPos + node.maxPos) * 0.5f) + shift;
+		vec3 half = absToA * ((node.maxPos - node.minPos) * 0.5f);
+		minPos = center - half;
+		maxPos = center + half;
+	}
+
+	static void findParents(const MeshView& mesh, vector<uint32_t>& parents) {
+		const BvhNode* nodes = mesh.nodes();
+		parents.assign(mesh.numNodes(), 0);
+		for (uint32_t n = 0; n < mesh.numNodes(); n++) {
+			if (nodes[n].count == 0) {
+				parents[n + 1] = n;
+				parents[nodes[n].first] = n;
+			}
+		}
+	}
+
+	bool apart(const NodePair& pair) const {
+		const BvhNode& a = meshA->nodes()[pair.a];
+		vec3 minB, maxB;
+		mappedBox(meshB->nodes()[pair.b], minB, maxB);
+		return glm::any(glm::greaterThan(a.minPos, maxB)) || glm::any(glm::greaterThan(minB, a.maxPos));
+	}
+
+	// whether two pairs differ only in a pair of sibling nodes, and the pair of their parent
+	bool siblings(const NodePair& first, const NodePair& second, NodePair& parent) const {
+		if (first.b == second.b && first.a != second.a && first.a != 0 && second.a != 0 && parentsA[first.a] == parentsA[second.a]) {
+			parent.a = parentsA[first.a];
+			parent.b = first.b;
+			return true;
+		}
+		if (first.a == second.a && first.b != second.b && first.b != 0 && second.b != 0 && parentsB[first.b] == parentsB[second.b]) {
+			parent.a = first.a;
+			parent.b = parentsB[first.b];
+			return true;
+		}
+		return false;
+	}
+
+	// the front is in depth first order, so the pairs a split left behind are next to each
+	// other, it is run through once as a stack, and the two pairs on top are replaced by their
+	// parent while all three are apart, which still covers every pair of triangles once
+	void coarsen() {
+		frontApart.resize(front.size());
+		size_t n = 0;
+		for (size_t i = 0; i < front.size(); i++) {
+			NodePair pair = front[i];
+			bool isApart = apart(pair);
+			NodePair parent;
+			while (isApart && n > 0 && frontApart[n - 1] && siblings(front[n - 1], pair, parent) && apart(parent)) {
+				pair = parent;
+				n--;
+			}
+			front[n] = pair;
+			frontApart[n] = isApart;
+			n++;
+		}
+		front.resize(n);
+	}
+
+	// test every triangle of leaf a against every triangle of leaf b
+	void collideLeaves(const BvhNode& leafA, const BvhNode& leafB, vector<MeshTrianglePair>& pairs) const {
+		const uint32_t* trianglesA = meshA->bvhTriangles();
+		const uint32_t* trianglesB = meshB->bvhTriangles();
+		const uint32_t* indicesA = meshA->indices();
+		const uint32_t* indicesB = meshB->indices();
+		// the corners of up to 16 triangles of b in the space of a, one array per corner and axis
+		alignas(16) float corners[3][3][BVH_MAX_LEAF_SIZE];
+		vec3 mapped[BVH_MAX_LEAF_SIZE][3];
+		for (uint32_t chunk = 0; chunk < leafB.count; chunk += BVH_MAX_LEAF_SIZE) {
+			uint32_t count = std::min(leafB.count - chunk, (uint32_t)BVH_MAX_LEAF_SIZE);
+			for (uint32_t i = 0; i < BVH_MAX_LEAF_SIZE; i++) {
+				// the lanes past the end repeat the last triangle
+				uint32_t t = trianglesB[leafB.first + chunk + std::min(i, count - 1)];
+				for (int k = 0; k < 3; k++) {
+					vec3 v = toA * meshB->vertex(indicesB[t * 3 + k]) + shift;
+					mapped[i][k] = v;
+					corners[k][0][i] = v.x;
+					corners[k][1][i] = v.y;
+					corners[k][2][i] = v.z;
+				}
+			}
+			for (uint32_t i = leafA.first; i < leafA.first + leafA.count; i++) {
+				uint32_t ta = trianglesA[i];
+				vec3 a0 = meshA->vertex(indicesA[ta * 3]), a1 = meshA->vertex(indicesA[ta * 3 + 1]), a2 = meshA->vertex(indicesA[ta * 3 + 2]);
+				vec3 n;
+				float offset, eps;
+				if (!trianglePlane(a0, a1, a2, n, offset, eps)) {
+					continue;
+				}
+				__m128 nx = _mm_set1_ps(n.x), ny = _mm_set1_ps(n.y), nz = _mm_set1_ps(n.z), c = _mm_set1_ps(offset);
+				__m128 above = _mm_set1_ps(eps), below = _mm_set1_ps(-eps);
+				for (uint32_t j = 0; j < count; j += 4) {
+					__m128 allAbove = _mm_castsi128_ps(_mm_set1_epi32(-1)), allBelow = allAbove;
+					for (int k = 0; k < 3; k++) {
+						__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_load_ps(&corners[k][0][j])),
+							_mm_mul_ps(ny, _mm_load_ps(&corners[k][1][j]))), _mm_add_ps(_mm_mul_ps(nz, _mm_load_ps(&corners[k][2][j])), c));
+						allAbove = _mm_and_ps(allAbove, _mm_cmpgt_ps(d, above));
+						allBelow = _mm_and_ps(allBelow, _mm_cmplt_ps(d, below));
+					}
+					int rejected = _mm_movemask_ps(_mm_or_ps(allAbove, allBelow));
+					for (uint32_t l = 0; l < 4 && j + l < count; l++) {
+						if (!(rejected & (1 << l)) && trianglesIntersect(a0, a1, a2, mapped[j + l][0], mapped[j + l][1], mapped[j + l][2])) {
+							MeshTrianglePair pair;
+							pair.a = ta;
+							pair.b = trianglesB[leafB.first + chunk + j + l];
+							pairs.push_back(pair);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// descend from one pair of nodes, leaving the pairs it stops at in the front of the work
+	void descend(NodePair start, Work& work) const {
+		const BvhNode* nodesA = meshA->nodes();
+		const BvhNode* nodesB = meshB->nodes();
+		work.stack.clear();
+		work.stack.push_back(start);
+		while (!work.stack.empty()) {
+			NodePair pair = work.stack.back();
+			work.stack.pop_back();
+			const BvhNode& a = nodesA[pair.a];
+			const BvhNode& b = nodesB[pair.b];
+			vec3 minB, maxB;
+			mappedBox(b, minB, maxB);
+			if (glm::any(glm::greaterThan(a.minPos, maxB)) || glm::any(glm::greaterThan(minB, a.maxPos))) {
+				work.front.push_back(pair);
+				continue;
+			}
+			if (a.count > 0 && b.count > 0) {
+				collideLeaves(a, b, work.pairs);
+				work.front.push_back(pair);
+				continue;
+			}
+			// split the larger of the two boxes
+			if (b.count > 0 || (a.count == 0 && boxArea(a.minPos, a.maxPos) >= boxArea(minB, maxB))) {
+				NodePair first = { pair.a + 1, pair.b }, second = { a.first, pair.b };
+				work.stack.push_back(second);
+				work.stack.push_back(first);
+			}
+			else {
+				NodePair first = { pair.a, pair.b + 1 }, second = { pair.a, b.first };
+				work.stack.push_back(second);
+				work.stack.push_back(first);
+			}
+		}
+	}
+
+	// descend from a pair of the front, one already found apart while coarsening stays as it is
+	void descendFront(size_t i, Work& work) const {
+		if (frontApart[i]) {
+			work.front.push_back(front[i]);
+		}
+		else {
+			descend(front[i], work);
+		}
+	}
+
+public:
+	MeshCollider() : meshA(nullptr), meshB(nullptr), rootFrontSize(0), toA(1.0f), absToA(1.0f), shift(0.0f) {}
+
+	// forget the front, the next call starts from the roots
+	void reset() {
+		front.clear();
+		rootFrontSize = 0;
+	}
+
+	// the node pairs the next call starts from
+	size_t frontSize() const {
+		return front.size();
+	}
+
+	// collect the pairs of intersecting triangles of a and b, placed by their poses, and return
+	// whether there are any, the front is kept as long as the same meshes are passed in
+	bool collide(const MeshView& a, const MeshPose& poseA, const MeshView& b, const MeshPose& poseB, vector<MeshTrianglePair>& pairs) {
+		pairs.clear();
+		if (&a != meshA || &b != meshB) {
+			meshA = &a;
+			meshB = &b;
+			findParents(a, parentsA);
+			findParents(b, parentsB);
+			reset();
+		}
+		if (a.numNodes() == 0 || b.numNodes() == 0) {
+			return false;
+		}
+		mat3 inverseA = transpose(poseA.rotation);
+		toA = inverseA * poseB.rotation * (poseB.scale / poseA.scale);
+		shift = inverseA * (poseB.position - poseA.position) / poseA.scale;
+		for (int i = 0; i < 3; i++) {
+			absToA[i] = abs(toA[i]);
+		}
+
+		// once the meshes are apart a single pair of roots is cheaper than any front
+		NodePair roots = { 0, 0 };
+		if (apart(roots)) {
+			front.assign(1, roots);
+			rootFrontSize = 1;
+			return false;
+		}
+		bool fromRoots = front.size() <= 1 || front.size() > rootFrontSize * MESH_COLLIDE_FRONT_GROWTH;
+		if (fromRoots) {
+			front.assign(1, roots);
+			frontApart.assign(1, 0);
+		}
+		else {
+			coarsen();
+		}
+		int numThreads = std::min((int)thread::hardware_concurrency(), (int)(front.size() / MESH_COLLIDE_PARALLEL_PAIRS));
+		if (numThreads <= 1) {
+			Work work;
+			for (size_t i = 0; i < front.size(); i++) {
+				descendFront(i, work);
+			}
+			front.swap(work.front);
+			pairs.swap(work.pairs);
+		}
+		else {
+			vector<Work> works(numThreads);
+			vector<thread> workers;
+			for (int t = 0; t < numThreads; t++) {
+				workers.push_back(thread([this, t, numThreads, &works]() {
+					size_t begin = front.size() * t / numThreads, end = front.size() * (t + 1) / numThreads;
+					for (size_t i = begin; i < end; i++) {
+						descendFront(i, works[t]);
+					}
+				}));
+			}
+			for (auto& w : workers) {
+				w.join();
+			}
+			front.clear();
+			for (auto& w : works) {
+				front.insert(front.end(), w.front.begin(), w.front.end());
+				pairs.insert(pairs.end(), w.pairs.begin(), w.pairs.end());
+			}
+		}
+		if (fromRoots) {
+			rootFrontSize = front.size();
+		}
+		return !pairs.empty();
+	}
+};
+
+#endif
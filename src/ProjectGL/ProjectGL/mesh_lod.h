@@ -0,0 +1,81 @@
+// coarser levels of detail of a model, for drawing it from far away and as cheaper collision
+// proxies, each level keeps a quarter of the triangles of the one before
+// the levels are simplified from the full mesh on one thread each and cached next to it as
+// model.ply.lod<level>.mcache, made from the same source so they go stale together
+
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include "mesh_cache.h"
+#include "mesh_simplify.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+const int MESH_LOD_LEVELS = 4; // the full mesh and three coarser ones
+const size_t MESH_LOD_RATIO = 4;
+const size_t MESH_LOD_MIN_TRIANGLES = 256;
+const float MESH_LOD_MAX_ERROR = 0.01f; // mean distance a level may move the surface, relative to the diagonal of the model
+
+inline string meshLodCachePath(const char* path, int level) {
+	return string(path) + ".lod" + to_string(level) + MESH_CACHE_SUFFIX;
+}
+
+// the vertices and triangles of a view
+inline void copyMesh(const MeshView& view, Mesh& mesh) {
+	mesh.clear();
+	mesh.x.assign(view.x(), view.x() + view.numVertices());
+	mesh.y.assign(view.y(), view.y() + view.numVertices());
+	mesh.z.assign(view.z(), view.z() + view.numVertices());
+	mesh.indices.assign(view.indices(), view.indices() + view.numTriangles() * 3);
+}
+
+// load a model into lods[0] and its coarser levels into lods[1] to lods[numLevels - 1],
+// simplifying the levels whose caches are stale
+inline bool loadMeshLods(const char* path, MeshView* lods, int numLevels) {
+	if (!loadMesh(path, lods[0])) {
+		return false;
+	}
+	MeshSource source;
+	if (!describeMeshSource(path, source)) {
+		return false;
+	}
+	vector<int> stale;
+	for (int level = 1; level < numLevels; level++) {
+		if (!lods[level].openCache(meshLodCachePath(path, level).c_str(), source)) {
+			stale.push_back(level);
+		}
+	}
+	if (stale.empty()) {
+		return true;
+	}
+
+	Mesh full;
+	copyMesh(lods[0], full);
+	vec3 minPos, maxPos;
+	full.bounds(minPos, maxPos);
+	float maxError = MESH_LOD_MAX_ERROR * length(maxPos - minPos);
+	vector<thread> workers;
+	for (int level : stale) {
+		workers.push_back(thread([level, path, &full, &source, maxError, lods]() {
+			size_t target = full.numTriangles();
+			for (int i = 0; i < level; i++) {
+				target /= MESH_LOD_RATIO;
+			}
+			Mesh coarse;
+			MeshSimplifier().simplify(full, std::max(target, MESH_LOD_MIN_TRIANGLES), maxError, coarse);
+			coarse.computeNormals();
+			cacheMesh(coarse, source, meshLodCachePath(path, level), lods[level]);
+		}));
+	}
+	for (auto& w : workers) {
+		w.join();
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,272 @@
+// reordering of a mesh for locality, run once before it is cached
+// the triangles are ordered greedily so that they reuse the vertices of the ones just drawn,
+// which keeps the post-transform cache of the gpu warm, then runs of that order are sorted
+// so that the outer parts of the model are drawn first and hide the inner ones, and last
+// the vertices are renumbered in the order the triangles first use them, so the arrays
+// are read nearly front to back by the gpu and by the queries on the cpu
+// reference: Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006
+// Pedro Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007
+
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "mesh.h"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// the cache the triangle order is scored against, larger than that of most gpus so the
+// order stays good for all of them
+const int VERTEX_CACHE_SIZE = 32;
+const float VERTEX_CACHE_DECAY = 1.5f;
+const float VERTEX_LAST_TRIANGLE_SCORE = 0.75f; // the vertices of the last triangle, lower so it is not drawn again
+const float VERTEX_VALENCE_SCALE = 2.0f;
+const float VERTEX_VALENCE_POWER = 0.5f;
+const int VERTEX_VALENCE_TABLE = 64; // larger valences are scored without the table
+
+// overdraw clusters start where the order restarts with three new vertices in a cache of
+// this size, and are never smaller than the minimum
+const int OVERDRAW_CACHE_SIZE = 16;
+const size_t OVERDRAW_MIN_CLUSTER = 64;
+
+class VertexCacheOptimizer {
+private:
+	float cacheScores[VERTEX_CACHE_SIZE];
+	float valenceScores[VERTEX_VALENCE_TABLE];
+
+	// how much a vertex wants its triangles drawn next, from where it is in the cache and how
+	// many of its triangles are left, the last ones are drawn early so no lone triangles remain
+	float score(int cachePos, uint32_t remaining) const {
+		if (remaining == 0) {
+			return -1.0f;
+		}
+		float s = cachePos >= 0 ? cacheScores[cachePos] : 0.0f;
+		return s + (remaining < (uint32_t)VERTEX_VALENCE_TABLE ? valenceScores[remaining] :
+			VERTEX_VALENCE_SCALE * powf((float)remaining, -VERTEX_VALENCE_POWER));
+	}
+
+public:
+	VertexCacheOptimizer() {
+		for (int i = 0; i < VERTEX_CACHE_SIZE; i++) {
+			cacheScores[i] = i < 3 ? VERTEX_LAST_TRIANGLE_SCORE :
+				powf(1.0f - (float)(i - 3) / (VERTEX_CACHE_SIZE - 3), VERTEX_CACHE_DECAY);
+		}
+		valenceScores[0] = 0.0f;
+		for (int i = 1; i < VERTEX_VALENCE_TABLE; i++) {
+			valenceScores[i] = VERTEX_VALENCE_SCALE * powf((float)i, -VERTEX_VALENCE_POWER);
+		}
+	}
+
+	// reorder the triangles of indices in place
+	void optimize(vector<uint32_t>& indices, size_t numVertices) const {
+		size_t numTriangles = indices.size() / 3;
+		if (numTriangles == 0) {
+			return;
+		}
+		// the triangles around each vertex, the ones not drawn yet are kept at the front
+		vector<uint32_t> remaining(numVertices, 0);
+		for (uint32_t v : indices) {
+			remaining[v]++;
+		}
+		vector<size_t> offsets(numVertices + 1, 0);
+		for (size_t v = 0; v < numVertices; v++) {
+			offsets[v + 1] = offsets[v] + remaining[v];
+		}
+		vector<uint32_t> adjacency(indices.size());
+		{
+			vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+			}
+		}
+		vector<int> cachePos(numVertices, -1);
+		vector<float> vertexScores(numVertices);
+		for (size_t v = 0; v < numVertices; v++) {
+			vertexScores[v] = score(-1, remaining[v]);
+		}
+		vector<char> drawn(numTriangles, 0);
+		int best = -1;
+		float bestScore = -1.0f;
+		for (size_t t = 0; t < numTriangles; t++) {
+			float s = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+			if (s > bestScore) {
+				bestScore = s;
+				best = (int)t;
+			}
+		}
+
+		vector<uint32_t> order;
+		order.reserve(indices.size());
+		uint32_t cache[VERTEX_CACHE_SIZE + 3];
+		uint32_t newCache[VERTEX_CACHE_SIZE + 3];
+		int cacheCount = 0;
+		size_t scan = 0; // the triangles before this are all drawn
+		for (size_t n = 0; n < numTriangles; n++) {
+			if (best < 0) {
+				// nothing in the cache has triangles left, continue with the first one not drawn
+				while (drawn[scan]) {
+					scan++;
+				}
+				best = (int)scan;
+			}
+			const uint32_t* tri = &indices[(size_t)best * 3];
+			drawn[best] = 1;
+			int newCount = 0;
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = tri[k];
+				order.push_back(v);
+				// move the triangle out of the front of the vertex's list
+				uint32_t* list = &adjacency[offsets[v]];
+				for (uint32_t i = 0; i < remaining[v]; i++) {
+					if (list[i] == (uint32_t)best) {
+						std::swap(list[i], list[remaining[v] - 1]);
+						break;
+					}
+				}
+				remaining[v]--;
+				if (std::find(newCache, newCache + newCount, v) == newCache + newCount) {
+					newCache[newCount++] = v;
+				}
+			}
+			for (int i = 0; i < cacheCount; i++) {
+				if (std::find(newCache, newCache + newCount, cache[i]) == newCache + newCount) {
+					newCache[newCount++] = cache[i];
+				}
+			}
+			// rescore the vertices that moved or fell out of the cache
+			for (int i = 0; i < newCount; i++) {
+				uint32_t v = newCache[i];
+				cachePos[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+				vertexScores[v] = score(cachePos[v], remaining[v]);
+			}
+			// and the triangles around them, the best of which is drawn next
+			best = -1;
+			bestScore = -1.0f;
+			for (int i = 0; i < newCount; i++) {
+				uint32_t v = newCache[i];
+				for (uint32_t j = 0; j < remaining[v]; j++) {
+					uint32_t t = adjacency[offsets[v] + j];
+					float s = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+					if (s > bestScore) {
+						bestScore = s;
+						best = (int)t;
+					}
+				}
+			}
+			cacheCount = std::min(newCount, VERTEX_CACHE_SIZE);
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+		indices.swap(order);
+	}
+};
+
+// sort runs of the triangle order so that the ones facing out from the middle of the model
+// are drawn first, the order within a run is kept so the cache stays warm
+inline void sortClustersForOverdraw(const Mesh& mesh, vector<uint32_t>& indices) {
+	size_t numTriangles = indices.size() / 3;
+	// a run ends where a triangle finds none of its vertices in a fifo cache
+	vector<size_t> starts;
+	vector<int64_t> cachedAt(mesh.numVertices(), -OVERDRAW_CACHE_SIZE - 1);
+	int64_t misses = 0;
+	for (size_t t = 0; t < numTriangles; t++) {
+		int newVertices = 0;
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[t * 3 + k];
+			if (misses - cachedAt[v] > OVERDRAW_CACHE_SIZE) {
+				cachedAt[v] = misses++;
+				newVertices++;
+			}
+		}
+		if (starts.empty() || (newVertices == 3 && t - starts.back() >= OVERDRAW_MIN_CLUSTER)) {
+			starts.push_back(t);
+		}
+	}
+	starts.push_back(numTriangles);
+	if (starts.size() <= 2) {
+		return;
+	}
+
+	vec3 minPos, maxPos;
+	mesh.bounds(minPos, maxPos);
+	vec3 center = (minPos + maxPos) * 0.5f;
+	size_t numClusters = starts.size() - 1;
+	vector<float> keys(numClusters);
+	for (size_t c = 0; c < numClusters; c++) {
+		vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+			vec3 a = mesh.vertex(indices[t * 3]), b = mesh.vertex(indices[t * 3 + 1]), d = mesh.vertex(indices[t * 3 + 2]);
+			vec3 n = cross(b - a, d - a);
+			float w = length(n);
+			centroid += (a + b + d) * (w / 3.0f);
+			normal += n;
+			area += w;
+		}
+		float len = length(normal);
+		keys[c] = area > 0.0f && len > 0.0f ? dot(centroid / area - center, normal / len) : 0.0f;
+	}
+	vector<size_t> clusters(numClusters);
+	for (size_t c = 0; c < numClusters; c++) {
+		clusters[c] = c;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+	vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (size_t c : clusters) {
+		sorted.insert(sorted.end(), indices.begin() + starts[c] * 3, indices.begin() + starts[c + 1] * 3);
+	}
+	indices.swap(sorted);
+}
+
+// renumber the vertices in the order the triangles first use them, unused ones go last
+inline void reorderVertices(Mesh& mesh) {
+	size_t numVertices = mesh.numVertices();
+	vector<uint32_t> remap(numVertices, UINT32_MAX);
+	uint32_t next = 0;
+	for (auto& v : mesh.indices) {
+		if (remap[v] == UINT32_MAX) {
+			remap[v] = next++;
+		}
+		v = remap[v];
+	}
+	for (size_t v = 0; v < numVertices; v++) {
+		if (remap[v] == UINT32_MAX) {
+			remap[v] = next++;
+		}
+	}
+	auto permute = [&remap](vector<float>& values) {
+		if (values.size() != remap.size()) {
+			return;
+		}
+		vector<float> moved(values.size());
+		for (size_t v = 0; v < values.size(); v++) {
+			moved[remap[v]] = values[v];
+		}
+		values.swap(moved);
+	};
+	permute(mesh.x);
+	permute(mesh.y);
+	permute(mesh.z);
+	permute(mesh.nx);
+	permute(mesh.ny);
+	permute(mesh.nz);
+	for (auto& p : mesh.properties) {
+		permute(p.values);
+	}
+}
+
+// the whole stage, the clusters are sorted only when sortForOverdraw is set
+inline void optimizeMesh(Mesh& mesh, bool sortForOverdraw) {
+	VertexCacheOptimizer().optimize(mesh.indices, mesh.numVertices());
+	if (sortForOverdraw) {
+		sortClustersForOverdraw(mesh, mesh.indices);
+	}
+	reorderVertices(mesh);
+}
+
+#endif
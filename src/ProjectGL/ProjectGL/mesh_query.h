@@ -0,0 +1,184 @@
+// proximity queries of points and spheres against a mesh, through its bvh
+// the traversal keeps its own stack and visits the nearer child first, so the
+// search radius shrinks quickly and most of the tree is never touched
+
+#ifndef MESH_QUERY_H
+#define MESH_QUERY_H
+
+#include "mesh_cache.h"
+#include "triangle.h"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// beyond this many radii of a node the winding number of its triangles is taken from its dipole
+const float WINDING_DIPOLE_DISTANCE = 2.0f;
+const float WINDING_FULL_ANGLE = 4.0f * 3.14159265f; // the solid angle of a whole sphere
+
+struct MeshHit {
+	vec3 point; // on the surface
+	float distance;
+	uint32_t triangle;
+};
+
+// the point of the mesh nearest to p within maxDistance, false if there is none
+inline bool nearestPointOnMesh(const MeshView& mesh, const vec3& p, float maxDistance, MeshHit& hit) {
+	if (mesh.numNodes() == 0) {
+		return false;
+	}
+	const BvhNode* nodes = mesh.nodes();
+	const uint32_t* triangles = mesh.bvhTriangles();
+	const uint32_t* indices = mesh.indices();
+	float best = maxDistance * maxDistance;
+	bool found = false;
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	if (boxDistanceSquared(p, nodes[0].minPos, nodes[0].maxPos) > best) {
+		return false;
+	}
+	stack[top++] = 0;
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+		if (boxDistanceSquared(p, node.minPos, node.maxPos) > best) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				uint32_t t = triangles[i];
+				vec3 q = closestPointOnTriangle(p, mesh.vertex(indices[t * 3]), mesh.vertex(indices[t * 3 + 1]), mesh.vertex(indices[t * 3 + 2]));
+				vec3 d = q - p;
+				float dd = dot(d, d);
+				if (dd <= best) {
+					best = dd;
+					hit.point = q;
+					hit.triangle = t;
+					found = true;
+				}
+			}
+			continue;
+		}
+		uint32_t first = (uint32_t)(&node - nodes) + 1, second = node.first;
+		float dFirst = boxDistanceSquared(p, nodes[first].minPos, nodes[first].maxPos);
+		float dSecond = boxDistanceSquared(p, nodes[second].minPos, nodes[second].maxPos);
+		// the nearer child is popped first
+		if (dFirst < dSecond) {
+			if (dSecond <= best) stack[top++] = second;
+			if (dFirst <= best) stack[top++] = first;
+		}
+		else {
+			if (dFirst <= best) stack[top++] = first;
+			if (dSecond <= best) stack[top++] = second;
+		}
+	}
+	if (found) {
+		hit.distance = sqrtf(best);
+	}
+	return found;
+}
+
+// the triangles under a bvh node as seen from far away, a dipole at their area weighted centroid
+struct BvhDipole {
+	vec3 center;
+	float radius; // of the sphere about center that holds the node
+	vec3 normal; // the sum of the normals of the triangles scaled by their areas
+};
+
+// one dipole per bvh node, computed from the leaves up since children follow their parents
+inline void computeDipoles(const MeshView& mesh, vector<BvhDipole>& dipoles) {
+	const BvhNode* nodes = mesh.nodes();
+	const uint32_t* triangles = mesh.bvhTriangles();
+	const uint32_t* indices = mesh.indices();
+	dipoles.resize(mesh.numNodes());
+	vector<float> areas(mesh.numNodes());
+	for (size_t n = mesh.numNodes(); n-- > 0;) {
+		const BvhNode& node = nodes[n];
+		BvhDipole& dipole = dipoles[n];
+		vec3 weighted(0.0f);
+		float area = 0.0f;
+		dipole.normal = vec3(0.0f);
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				uint32_t t = triangles[i];
+				vec3 a = mesh.vertex(indices[t * 3]), b = mesh.vertex(indices[t * 3 + 1]), c = mesh.vertex(indices[t * 3 + 2]);
+				vec3 normal = 0.5f * cross(b - a, c - a);
+				float triangleArea = length(normal);
+				dipole.normal += normal;
+				weighted += (a + b + c) * (triangleArea / 3.0f);
+				area += triangleArea;
+			}
+		}
+		else {
+			size_t first = n + 1, second = node.first;
+			dipole.normal = dipoles[first].normal + dipoles[second].normal;
+			weighted = dipoles[first].center * areas[first] + dipoles[second].center * areas[second];
+			area = areas[first] + areas[second];
+		}
+		areas[n] = area;
+		dipole.center = area > 0.0f ? weighted / area : (node.minPos + node.maxPos) * 0.5f;
+		dipole.radius = length(glm::max(abs(node.minPos - dipole.center), abs(node.maxPos - dipole.center)));
+	}
+}
+
+// the generalized winding number of the mesh at p, 1 inside a closed surface and 0 outside,
+// which still tells the two apart for surfaces with holes or that pass through themselves,
+// the triangles of the nodes near p are summed exactly and the farther ones by their dipoles
+// reference: Gavin Barill et al., "Fast Winding Numbers for Soups and Clouds", 2018
+inline float windingNumber(const MeshView& mesh, const vector<BvhDipole>& dipoles, const vec3& p) {
+	if (mesh.numNodes() == 0) {
+		return 0.0f;
+	}
+	const BvhNode* nodes = mesh.nodes();
+	const uint32_t* triangles = mesh.bvhTriangles();
+	const uint32_t* indices = mesh.indices();
+	float angle = 0.0f;
+	uint32_t stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t n = stack[--top];
+		const BvhNode& node = nodes[n];
+		const BvhDipole& dipole = dipoles[n];
+		vec3 r = dipole.center - p;
+		float rr = dot(r, r);
+		float reach = WINDING_DIPOLE_DISTANCE * dipole.radius;
+		if (rr > reach * reach) {
+			angle += dot(r, dipole.normal) / (rr * sqrtf(rr));
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				uint32_t t = triangles[i];
+				angle += triangleSolidAngle(p, mesh.vertex(indices[t * 3]), mesh.vertex(indices[t * 3 + 1]), mesh.vertex(indices[t * 3 + 2]));
+			}
+			continue;
+		}
+		stack[top++] = node.first;
+		stack[top++] = n + 1;
+	}
+	return angle / WINDING_FULL_ANGLE;
+}
+
+// the winding number summed over every triangle, slow but without the dipole approximation
+inline float exactWindingNumber(const MeshView& mesh, const vec3& p) {
+	const uint32_t* indices = mesh.indices();
+	double angle = 0.0;
+	for (size_t t = 0; t < mesh.numTriangles(); t++) {
+		angle += triangleSolidAngle(p, mesh.vertex(indices[t * 3]), mesh.vertex(indices[t * 3 + 1]), mesh.vertex(indices[t * 3 + 2]));
+	}
+	return (float)(angle / WINDING_FULL_ANGLE);
+}
+
+// the geometric normal of a triangle, of unit length
+inline vec3 triangleNormal(const MeshView& mesh, uint32_t t) {
+	const uint32_t* indices = mesh.indices();
+	vec3 a = mesh.vertex(indices[t * 3]);
+	vec3 n = cross(mesh.vertex(indices[t * 3 + 1]) - a, mesh.vertex(indices[t * 3 + 2]) - a);
+	float len = length(n);
+	return len > 0.0f ? n / len : vec3(0.0f, 1.0f, 0.0f);
+}
+
+#endif
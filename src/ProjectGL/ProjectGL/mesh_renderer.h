@@ -0,0 +1,77 @@
+// draws a loaded mesh with resources/shader/vertex.vs and frag.fs
+// the SoA arrays of the mesh are interleaved into one position and normal buffer on upload
+
+#ifndef MESH_RENDERER_H
+#define MESH_RENDERER_H
+
+#include <glad/glad.h>
+#include <vector>
+#include "mesh_cache.h"
+
+using namespace std;
+
+class MeshRenderer {
+private:
+	unsigned int vao;
+	unsigned int vbo;
+	unsigned int ebo;
+	size_t numIndices;
+
+public:
+	MeshRenderer() : vao(0), vbo(0), ebo(0), numIndices(0) {}
+
+	MeshRenderer(const MeshRenderer&) = delete;
+	MeshRenderer& operator=(const MeshRenderer&) = delete;
+
+	~MeshRenderer() {
+		release();
+	}
+
+	// needs a current context
+	void init(const MeshView& mesh) {
+		vector<float> vertices(mesh.numVertices() * 6);
+		for (size_t i = 0; i < mesh.numVertices(); i++) {
+			vertices[i * 6] = mesh.x()[i];
+			vertices[i * 6 + 1] = mesh.y()[i];
+			vertices[i * 6 + 2] = mesh.z()[i];
+			vertices[i * 6 + 3] = mesh.nx()[i];
+			vertices[i * 6 + 4] = mesh.ny()[i];
+			vertices[i * 6 + 5] = mesh.nz()[i];
+		}
+		numIndices = mesh.numTriangles() * 3;
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(uint32_t), mesh.indices(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// the shader must be in use with its model matrix set
+	void draw() const {
+		glBindVertexArray(vao);
+		glDrawElements(GL_TRIANGLES, (GLsizei)numIndices, GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	}
+
+	void release() {
+		if (vao != 0) {
+			glDeleteVertexArrays(1, &vao);
+			glDeleteBuffers(1, &vbo);
+			glDeleteBuffers(1, &ebo);
+		}
+		vao = vbo = ebo = 0;
+		numIndices = 0;
+	}
+};
+
+#endif
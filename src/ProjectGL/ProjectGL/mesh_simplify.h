@@ -0,0 +1,349 @@
+// simplification of a mesh by collapsing edges in the order of the error they add
+// every vertex sums the planes of the triangles around it in a quadric, whose value at a point
+// is the weighted sum of the squared distances to those planes, an edge is collapsed to the
+// point where the quadric of its two ends is smallest and that value is its cost
+// the edges are kept in a heap and an entry is dropped when popped if one of its ends changed
+// since it was pushed, the open borders of scans get extra planes across them so they keep
+// their shape, and collapses that would fold a triangle over are skipped
+// reference: Michael Garland and Paul Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997
+
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include "mesh.h"
+#include <vector>
+#include <queue>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const double QUADRIC_BORDER_WEIGHT = 10.0; // of the planes across open borders, relative to the triangle planes
+const float QUADRIC_FOLD_COSINE = 0.2f; // a triangle may not turn further than this from its normal
+
+// a symmetric 4x4 matrix of plane equations, stored as its upper triangle
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight; // the total weight of the planes, for the mean error
+
+	Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+	// the plane n.x + d = 0 with n of unit length
+	Quadric(const dvec3& n, double d, double w) :
+		a2(w * n.x * n.x), ab(w * n.x * n.y), ac(w * n.x * n.z), ad(w * n.x * d),
+		b2(w * n.y * n.y), bc(w * n.y * n.z), bd(w * n.y * d),
+		c2(w * n.z * n.z), cd(w * n.z * d), d2(w * d * d), weight(w) {}
+
+	Quadric& operator+=(const Quadric& q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd; d2 += q.d2;
+		weight += q.weight;
+		return *this;
+	}
+
+	double error(const dvec3& p) const {
+		return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x +
+			b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y +
+			c2 * p.z * p.z + 2 * cd * p.z + d2;
+	}
+
+	// the point of the smallest error, false if it is not unique
+	bool minimum(dvec3& p) const {
+		double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+		double scale = a2 * a2 + b2 * b2 + c2 * c2;
+		if (fabs(det) <= 1e-12 * scale * sqrt(scale)) {
+			return false;
+		}
+		// cramer's rule on the upper left 3x3 block against -(ad, bd, cd)
+		p.x = -(ad * (b2 * c2 - bc * bc) - ab * (bd * c2 - bc * cd) + ac * (bd * bc - b2 * cd)) / det;
+		p.y = -(a2 * (bd * c2 - cd * bc) - ad * (ab * c2 - bc * ac) + ac * (ab * cd - bd * ac)) / det;
+		p.z = -(a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bd * ac) + ad * (ab * bc - b2 * ac)) / det;
+		return true;
+	}
+};
+
+class MeshSimplifier {
+private:
+	struct Candidate {
+		double cost;
+		uint32_t u;
+		uint32_t v;
+		uint32_t stamp; // the sum of the versions of u and v when pushed
+
+		bool operator<(const Candidate& c) const {
+			return cost > c.cost; // the cheapest on top
+		}
+	};
+
+	vector<dvec3> positions;
+	vector<Quadric> quadrics;
+	vector<uint32_t> versions;
+	vector<char> removed; // vertices merged into another one
+	vector<uint32_t> triangles; // three per triangle, updated as vertices merge
+	vector<char> dead; // triangles that collapsed to an edge
+	vector<vector<uint32_t> > around; // triangles around each vertex, dead ones are dropped lazily
+	priority_queue<Candidate> heap;
+	size_t liveTriangles;
+
+	// where to put u and v when they are merged and what that costs
+	double collapseCost(uint32_t u, uint32_t v, dvec3& target) const {
+		Quadric q = quadrics[u];
+		q += quadrics[v];
+		dvec3 options[3] = { positions[u], positions[v], (positions[u] + positions[v]) * 0.5 };
+		double best = INFINITY;
+		if (q.minimum(target)) {
+			best = q.error(target);
+		}
+		for (auto& p : options) {
+			double e = q.error(p);
+			if (e < best) {
+				best = e;
+				target = p;
+			}
+		}
+		return std::max(best, 0.0);
+	}
+
+	void push(uint32_t u, uint32_t v) {
+		Candidate c;
+		dvec3 target;
+		c.cost = collapseCost(u, v, target);
+		c.u = u;
+		c.v = v;
+		c.stamp = versions[u] + versions[v];
+		heap.push(c);
+	}
+
+	// the vertices sharing a live triangle with v
+	void neighbours(uint32_t v, vector<uint32_t>& result) const {
+		result.clear();
+		for (uint32_t t : around[v]) {
+			if (dead[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t w = triangles[t * 3 + k];
+				if (w != v && std::find(result.begin(), result.end(), w) == result.end()) {
+					result.push_back(w);
+				}
+			}
+		}
+	}
+
+	// whether moving v to p turns one of its triangles that does not contain other too far
+	bool folds(uint32_t v, uint32_t other, const dvec3& p) const {
+		for (uint32_t t : around[v]) {
+			if (dead[t]) {
+				continue;
+			}
+			const uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == other || tri[1] == other || tri[2] == other) {
+				continue;
+			}
+			dvec3 a = positions[tri[0]], b = positions[tri[1]], c = positions[tri[2]];
+			dvec3 before = cross(b - a, c - a);
+			if (tri[0] == v) a = p;
+			else if (tri[1] == v) b = p;
+			else c = p;
+			dvec3 after = cross(b - a, c - a);
+			double lb = length(before), la = length(after);
+			if (la <= 0.0 || (lb > 0.0 && dot(before, after) < QUADRIC_FOLD_COSINE * lb * la)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// merge v into u at p, return false when that would spoil the surface
+	bool collapse(uint32_t u, uint32_t v, const dvec3& p, vector<uint32_t>& scratchU, vector<uint32_t>& scratchV) {
+		// the ends may share only the one or two vertices of the triangles on the edge
+		neighbours(u, scratchU);
+		neighbours(v, scratchV);
+		int shared = 0, onEdge = 0;
+		for (uint32_t w : scratchU) {
+			if (std::find(scratchV.begin(), scratchV.end(), w) != scratchV.end()) {
+				shared++;
+			}
+		}
+		for (uint32_t t : around[u]) {
+			if (!dead[t] && (triangles[t * 3] == v || triangles[t * 3 + 1] == v || triangles[t * 3 + 2] == v)) {
+				onEdge++;
+			}
+		}
+		if (shared > onEdge || folds(u, v, p) || folds(v, u, p)) {
+			return false;
+		}
+		for (uint32_t t : around[v]) {
+			if (dead[t]) {
+				continue;
+			}
+			uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == u || tri[1] == u || tri[2] == u) {
+				dead[t] = 1;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (tri[k] == v) {
+					tri[k] = u;
+				}
+			}
+			around[u].push_back(t);
+		}
+		around[v].clear();
+		around[v].shrink_to_fit();
+		// drop the triangles that died from the list of u too
+		around[u].erase(std::remove_if(around[u].begin(), around[u].end(), [this](uint32_t t) { return dead[t] != 0; }), around[u].end());
+		positions[u] = p;
+		quadrics[u] += quadrics[v];
+		removed[v] = 1;
+		versions[u]++;
+		versions[v]++;
+		neighbours(u, scratchU);
+		for (uint32_t w : scratchU) {
+			push(u, w);
+		}
+		return true;
+	}
+
+public:
+	// collapse edges of mesh until at most targetTriangles are left or every remaining collapse
+	// would move the surface by more than maxError on average, the result gets no normals and
+	// keeps the extra properties of the vertices that survive
+	void simplify(const Mesh& mesh, size_t targetTriangles, float maxError, Mesh& result) {
+		size_t numVertices = mesh.numVertices();
+		size_t numTriangles = mesh.numTriangles();
+		positions.resize(numVertices);
+		for (size_t i = 0; i < numVertices; i++) {
+			positions[i] = dvec3(mesh.vertex(i));
+		}
+		quadrics.assign(numVertices, Quadric());
+		versions.assign(numVertices, 0);
+		removed.assign(numVertices, 0);
+		triangles = mesh.indices;
+		dead.assign(numTriangles, 0);
+		around.assign(numVertices, vector<uint32_t>());
+		heap = priority_queue<Candidate>();
+		liveTriangles = numTriangles;
+
+		// the planes of the triangles, weighted by area
+		for (size_t t = 0; t < numTriangles; t++) {
+			const uint32_t* tri = &triangles[t * 3];
+			if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+				dead[t] = 1;
+				liveTriangles--;
+				continue;
+			}
+			dvec3 n = cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+			double area = length(n) * 0.5;
+			Quadric q;
+			if (area > 0.0) {
+				n /= area * 2.0;
+				q = Quadric(n, -dot(n, positions[tri[0]]), area);
+			}
+			for (int k = 0; k < 3; k++) {
+				quadrics[tri[k]] += q;
+				around[tri[k]].push_back((uint32_t)t);
+			}
+		}
+		// the edges, found once from each end with the smaller index, with the ones on open
+		// borders belonging to a single triangle
+		vector<uint32_t> scratchU, scratchV;
+		for (uint32_t u = 0; u < numVertices; u++) {
+			neighbours(u, scratchU);
+			for (uint32_t v : scratchU) {
+				if (v < u) {
+					continue;
+				}
+				uint32_t only = UINT32_MAX;
+				int count = 0;
+				for (uint32_t t : around[u]) {
+					const uint32_t* tri = &triangles[t * 3];
+					if (!dead[t] && (tri[0] == v || tri[1] == v || tri[2] == v)) {
+						only = t;
+						count++;
+					}
+				}
+				if (count == 1) {
+					const uint32_t* tri = &triangles[only * 3];
+					dvec3 edge = positions[v] - positions[u];
+					dvec3 face = cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+					dvec3 n = cross(edge, face);
+					double len = length(n);
+					if (len > 0.0) {
+						n /= len;
+						Quadric q(n, -dot(n, positions[u]), QUADRIC_BORDER_WEIGHT * dot(edge, edge));
+						quadrics[u] += q;
+						quadrics[v] += q;
+					}
+				}
+			}
+		}
+		for (uint32_t u = 0; u < numVertices; u++) {
+			neighbours(u, scratchU);
+			for (uint32_t v : scratchU) {
+				if (v > u) {
+					push(u, v);
+				}
+			}
+		}
+
+		double maxErrorSquared = (double)maxError * maxError;
+		while (liveTriangles > targetTriangles && !heap.empty()) {
+			Candidate c = heap.top();
+			heap.pop();
+			if (removed[c.u] || removed[c.v] || c.stamp != versions[c.u] + versions[c.v]) {
+				continue;
+			}
+			dvec3 target;
+			double cost = collapseCost(c.u, c.v, target);
+			double weight = quadrics[c.u].weight + quadrics[c.v].weight;
+			if (weight > 0.0 && cost / weight > maxErrorSquared) {
+				continue;
+			}
+			collapse(c.u, c.v, target, scratchU, scratchV);
+		}
+
+		// keep the vertices of the live triangles
+		result.clear();
+		vector<uint32_t> remap(numVertices, UINT32_MAX);
+		for (auto& p : mesh.properties) {
+			MeshProperty copy;
+			copy.name = p.name;
+			result.properties.push_back(copy);
+		}
+		for (size_t t = 0; t < numTriangles; t++) {
+			if (dead[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = triangles[t * 3 + k];
+				if (remap[v] == UINT32_MAX) {
+					remap[v] = (uint32_t)result.x.size();
+					result.x.push_back((float)positions[v].x);
+					result.y.push_back((float)positions[v].y);
+					result.z.push_back((float)positions[v].z);
+					for (size_t i = 0; i < mesh.properties.size(); i++) {
+						result.properties[i].values.push_back(mesh.properties[i].values[v]);
+					}
+				}
+				result.indices.push_back(remap[v]);
+			}
+		}
+		// release the working memory
+		positions = vector<dvec3>();
+		quadrics = vector<Quadric>();
+		versions = vector<uint32_t>();
+		removed = vector<char>();
+		triangles = vector<uint32_t>();
+		dead = vector<char>();
+		around = vector<vector<uint32_t> >();
+		heap = priority_queue<Candidate>();
+	}
+};
+
+#endif
@@ -0,0 +1,193 @@
+// the narrowphase of mixed shapes, run on the candidate pairs of a broadphase
+// the pairs are first sorted into one bucket per pair of shape types, then each bucket is
+// handed to its entry of a table built at compile time, a loop over the bucket with the
+// contact test of that pair inlined, so no call is made per pair to pick the test
+// the balls keep their own sphere only path in Detector::ballCollideCpu and on the gpu,
+// this is for the pairs that involve a capsule or a box
+
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "shapes.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// a shape in a ShapeSet, an index into the array of its type
+struct ShapeRef {
+	ShapeType type;
+	uint32_t index;
+};
+
+struct ShapePair {
+	ShapeRef a;
+	ShapeRef b;
+};
+
+// a pair that overlaps, a has the lower ShapeType of the two
+struct ShapeContact {
+	ShapeRef a;
+	ShapeRef b;
+	vec3 normal; // pushes a out of b
+	float depth; // how far a is inside b
+};
+
+// the shapes of a scene, one array per type
+struct ShapeSet {
+	vector<SphereShape> spheres;
+	vector<CapsuleShape> capsules;
+	vector<BoxShape> boxes;
+
+	void clear() {
+		spheres.clear();
+		capsules.clear();
+		boxes.clear();
+	}
+};
+
+// the ShapeType of a shape and its array in a ShapeSet
+template <typename S>
+struct ShapeTraits;
+
+template <>
+struct ShapeTraits<SphereShape> {
+	static const ShapeType type = SHAPE_SPHERE;
+	static vector<SphereShape>& of(ShapeSet& set) { return set.spheres; }
+	static const vector<SphereShape>& of(const ShapeSet& set) { return set.spheres; }
+};
+
+template <>
+struct ShapeTraits<CapsuleShape> {
+	static const ShapeType type = SHAPE_CAPSULE;
+	static vector<CapsuleShape>& of(ShapeSet& set) { return set.capsules; }
+	static const vector<CapsuleShape>& of(const ShapeSet& set) { return set.capsules; }
+};
+
+template <>
+struct ShapeTraits<BoxShape> {
+	static const ShapeType type = SHAPE_BOX;
+	static vector<BoxShape>& of(ShapeSet& set) { return set.boxes; }
+	static const vector<BoxShape>& of(const ShapeSet& set) { return set.boxes; }
+};
+
+// the shape of a ShapeType
+template <int Type>
+struct ShapeOfType;
+
+template <>
+struct ShapeOfType<SHAPE_SPHERE> {
+	typedef SphereShape Shape;
+};
+
+template <>
+struct ShapeOfType<SHAPE_CAPSULE> {
+	typedef CapsuleShape Shape;
+};
+
+template <>
+struct ShapeOfType<SHAPE_BOX> {
+	typedef BoxShape Shape;
+};
+
+// add a shape to its array and return where it went
+template <typename S>
+ShapeRef addShape(ShapeSet& set, const S& shape) {
+	vector<S>& shapes = ShapeTraits<S>::of(set);
+	ShapeRef ref;
+	ref.type = ShapeTraits<S>::type;
+	ref.index = (uint32_t)shapes.size();
+	shapes.push_back(shape);
+	return ref;
+}
+
+// the bounds of any shape in the set
+inline void shapeBounds(const ShapeSet& set, ShapeRef ref, vec3& minPos, vec3& maxPos) {
+	switch (ref.type) {
+	case SHAPE_SPHERE:
+		shapeBounds(set.spheres[ref.index], minPos, maxPos);
+		break;
+	case SHAPE_CAPSULE:
+		shapeBounds(set.capsules[ref.index], minPos, maxPos);
+		break;
+	default:
+		shapeBounds(set.boxes[ref.index], minPos, maxPos);
+		break;
+	}
+}
+
+// the surface of any shape in the set, for drawing
+inline void shapeMesh(const ShapeSet& set, ShapeRef ref, Mesh& mesh) {
+	switch (ref.type) {
+	case SHAPE_SPHERE:
+		shapeMesh(set.spheres[ref.index], mesh);
+		break;
+	case SHAPE_CAPSULE:
+		shapeMesh(set.capsules[ref.index], mesh);
+		break;
+	default:
+		shapeMesh(set.boxes[ref.index], mesh);
+		break;
+	}
+}
+
+// the pairs of one bucket, all of types A and B
+template <int A, int B>
+void collideBucket(const ShapeSet& set, const vector<ShapePair>& pairs, vector<ShapeContact>& contacts) {
+	typedef typename ShapeOfType<A>::Shape ShapeA;
+	typedef typename ShapeOfType<B>::Shape ShapeB;
+	const vector<ShapeA>& shapesA = ShapeTraits<ShapeA>::of(set);
+	const vector<ShapeB>& shapesB = ShapeTraits<ShapeB>::of(set);
+	for (const ShapePair& pair : pairs) {
+		ShapeContact contact;
+		if (collideShapes(shapesA[pair.a.index], shapesB[pair.b.index], contact.normal, contact.depth)) {
+			contact.a = pair.a;
+			contact.b = pair.b;
+			contacts.push_back(contact);
+		}
+	}
+}
+
+typedef void (*ShapeBucketCollider)(const ShapeSet&, const vector<ShapePair>&, vector<ShapeContact>&);
+
+// indexed by the types of a and b, a never has the higher type
+const ShapeBucketCollider SHAPE_PAIR_COLLIDERS[SHAPE_TYPES][SHAPE_TYPES] = {
+	{ collideBucket<SHAPE_SPHERE, SHAPE_SPHERE>, collideBucket<SHAPE_SPHERE, SHAPE_CAPSULE>, collideBucket<SHAPE_SPHERE, SHAPE_BOX> },
+	{ nullptr, collideBucket<SHAPE_CAPSULE, SHAPE_CAPSULE>, collideBucket<SHAPE_CAPSULE, SHAPE_BOX> },
+	{ nullptr, nullptr, collideBucket<SHAPE_BOX, SHAPE_BOX> },
+};
+
+class Narrowphase {
+private:
+	vector<ShapePair> buckets[SHAPE_TYPES][SHAPE_TYPES];
+
+public:
+	// the contacts of the pairs that overlap, the two shapes of a pair are swapped when the
+	// first has the higher type, the contacts come out grouped by pair of types
+	void collide(const ShapeSet& set, const vector<ShapePair>& pairs, vector<ShapeContact>& contacts) {
+		contacts.clear();
+		for (int a = 0; a < SHAPE_TYPES; a++) {
+			for (int b = a; b < SHAPE_TYPES; b++) {
+				buckets[a][b].clear();
+			}
+		}
+		for (ShapePair pair : pairs) {
+			if (pair.a.type > pair.b.type) {
+				std::swap(pair.a, pair.b);
+			}
+			buckets[pair.a.type][pair.b.type].push_back(pair);
+		}
+		for (int a = 0; a < SHAPE_TYPES; a++) {
+			for (int b = a; b < SHAPE_TYPES; b++) {
+				if (!buckets[a][b].empty()) {
+					SHAPE_PAIR_COLLIDERS[a][b](set, buckets[a][b], contacts);
+				}
+			}
+		}
+	}
+};
+
+#endif
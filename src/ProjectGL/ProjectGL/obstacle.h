@@ -0,0 +1,185 @@
+// a static triangle mesh the balls collide with, e.g. one of the models in bin/resources/model
+// the model is scaled uniformly and moved into the box, the balls are moved into the
+// model's own space instead of transforming the mesh
+// all the balls are queried against the bvh in one batch per step, after the balls
+// that cannot reach the mesh are rejected against its bounding box
+// with a baked signed distance field a query is a single grid lookup instead, the bvh
+// is still used for balls wider than the band of the field
+// the coarser levels of the model are loaded too, one of them can stand in for the full
+// mesh in the collisions and the renderer picks one by the distance to the camera
+
+#ifndef OBSTACLE_H
+#define OBSTACLE_H
+
+#include "octree.h"
+#include "mesh_cache.h"
+#include "mesh_lod.h"
+#include "mesh_query.h"
+#include "sdf.h"
+#include "mesh_collide.h"
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace glm;
+
+const int OBSTACLE_PARALLEL_BALLS = 4096; // fewer candidates are queried by one thread
+// the full mesh is drawn up to this many sizes of the model from the camera, and each doubling
+// of the distance beyond that drops a level
+const float OBSTACLE_LOD_DISTANCE = 2.0f;
+
+struct ObstacleContact {
+	int ball;
+	vec3 normal; // out of the surface, towards the ball center
+	float depth; // how far the ball is inside
+};
+
+class Obstacle {
+private:
+	MeshView lods[MESH_LOD_LEVELS];
+	const MeshView* mesh; // the level the balls collide with
+	SignedDistanceField field;
+	vec3 offset; // world position of the model origin
+	float scale; // world units per model unit
+	vec3 minPos; // world bounds
+	vec3 maxPos;
+	vector<int> candidates;
+
+	// the contact of one ball, false if it does not touch the mesh
+	bool contact(const Ball* b, ObstacleContact& result) const {
+		vec3 p = (b->pos - offset) / scale;
+		float r = b->radius / scale;
+		if (field.isBaked() && r < field.getBand()) {
+			vec3 gradient;
+			float d = field.sample(p, gradient);
+			float len = length(gradient);
+			if (d >= r) {
+				return false;
+			}
+			if (len > 0.0f) {
+				result.ball = b->index;
+				result.normal = gradient / len;
+				result.depth = (r - d) * scale;
+				return true;
+			}
+		}
+		MeshHit hit;
+		if (!nearestPointOnMesh(*mesh, p, r, hit)) {
+			return false;
+		}
+		result.ball = b->index;
+		// the center lies on the surface when the distance vanishes
+		result.normal = hit.distance > 1e-6f ? (p - hit.point) / hit.distance : triangleNormal(*mesh, hit.triangle);
+		result.depth = (r - hit.distance) * scale;
+		return true;
+	}
+
+public:
+	Obstacle() : mesh(&lods[0]), offset(0.0f), scale(1.0f), minPos(0.0f), maxPos(0.0f) {}
+
+	Obstacle(const Obstacle&) = delete;
+	Obstacle& operator=(const Obstacle&) = delete;
+
+	// load a model, scale it so its largest side is size and stand it on base, the balls
+	// collide with the given level of detail
+	bool load(const char* path, const vec3& base, float size, int collisionLevel = 0) {
+		if (!loadMeshLods(path, lods, MESH_LOD_LEVELS) || lods[0].numNodes() == 0) {
+			return false;
+		}
+		vec3 lo = lods[0].nodes()[0].minPos, hi = lods[0].nodes()[0].maxPos;
+		vec3 extent = hi - lo;
+		scale = size / std::max(extent.x, std::max(extent.y, extent.z));
+		offset = base - vec3((lo.x + hi.x) * 0.5f, lo.y, (lo.z + hi.z) * 0.5f) * scale;
+		mesh = &lods[std::max(0, std::min(collisionLevel, MESH_LOD_LEVELS - 1))];
+		if (mesh->numNodes() == 0) {
+			mesh = &lods[0];
+		}
+		// a simplified mesh may reach a little past the full one
+		minPos = glm::min(lo, mesh->nodes()[0].minPos) * scale + offset;
+		maxPos = glm::max(hi, mesh->nodes()[0].maxPos) * scale + offset;
+		return true;
+	}
+
+	// sample the mesh into a distance field with resolution cells along its longest side
+	void bakeField(int resolution) {
+		field.bake(*mesh, resolution);
+	}
+
+	// the cells of the field, out of samples, whose sign disagrees with the exact winding number
+	int checkField(int samples, int& checked) const {
+		return field.countSignErrors(*mesh, samples, checked);
+	}
+
+	// append a contact for every ball touching the mesh
+	void findContacts(const vector<Ball*>& balls, vector<ObstacleContact>& contacts) {
+		candidates.clear();
+		for (auto b : balls) {
+			if (boxDistanceSquared(b->pos, minPos, maxPos) < b->radius * b->radius) {
+				candidates.push_back(b->index);
+			}
+		}
+		int numThreads = std::min((int)thread::hardware_concurrency(), (int)candidates.size() / OBSTACLE_PARALLEL_BALLS);
+		if (numThreads <= 1) {
+			ObstacleContact c;
+			for (int i : candidates) {
+				if (contact(balls[i], c)) {
+					contacts.push_back(c);
+				}
+			}
+			return;
+		}
+		vector<vector<ObstacleContact> > found(numThreads);
+		vector<thread> workers;
+		for (int t = 0; t < numThreads; t++) {
+			workers.push_back(thread([this, t, numThreads, &balls, &found]() {
+				size_t begin = candidates.size() * t / numThreads, end = candidates.size() * (t + 1) / numThreads;
+				ObstacleContact c;
+				for (size_t i = begin; i < end; i++) {
+					if (contact(balls[candidates[i]], c)) {
+						found[t].push_back(c);
+					}
+				}
+			}));
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+		for (auto& f : found) {
+			contacts.insert(contacts.end(), f.begin(), f.end());
+		}
+	}
+
+	// the mesh the balls collide with
+	const MeshView& getMesh() const {
+		return *mesh;
+	}
+
+	const MeshView& getLod(int level) const {
+		return lods[level];
+	}
+
+	// the level of detail to draw the model with when seen from eye
+	int lodLevel(const vec3& eye) const {
+		float size = std::max(maxPos.x - minPos.x, std::max(maxPos.y - minPos.y, maxPos.z - minPos.z));
+		float distance = length(eye - (minPos + maxPos) * 0.5f) / (size * OBSTACLE_LOD_DISTANCE);
+		if (distance <= 1.0f) {
+			return 0;
+		}
+		return std::min(MESH_LOD_LEVELS - 1, 1 + (int)log2f(distance));
+	}
+
+	// where the model is, for colliding it with other meshes
+	MeshPose pose() const {
+		return MeshPose(mat3(1.0f), offset, scale);
+	}
+
+	// from model to world space
+	mat4 modelMatrix() const {
+		return glm::scale(glm::translate(mat4(1.0f), offset), vec3(scale));
+	}
+};
+
+#endif
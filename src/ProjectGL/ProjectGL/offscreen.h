@@ -0,0 +1,308 @@
+// rendering without a display: frames are drawn into a framebuffer object, read back
+// through two pixel pack buffers and written to disk on a worker thread
+// the readback of a frame is only started when it is drawn and collected one frame
+// later, so the cpu never waits for the gpu to finish the frame it just submitted
+
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+const int MAX_QUEUED_IMAGES = 4; // frames waiting for the writer before the renderer blocks
+
+// a framebuffer object with a colour and a depth renderbuffer
+class OffscreenTarget {
+private:
+	unsigned int fbo;
+	unsigned int colorBuffer;
+	unsigned int depthBuffer;
+	int width;
+	int height;
+
+public:
+	OffscreenTarget() : fbo(0), colorBuffer(0), depthBuffer(0), width(0), height(0) {}
+
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+	~OffscreenTarget() {
+		release();
+	}
+
+	bool init(int targetWidth, int targetHeight) {
+		width = targetWidth;
+		height = targetHeight;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			cout << "ERROR: OFFSCREEN FRAMEBUFFER IS INCOMPLETE!" << endl;
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			return false;
+		}
+		glViewport(0, 0, width, height);
+		return true;
+	}
+
+	void release() {
+		if (fbo != 0) {
+			glDeleteFramebuffers(1, &fbo);
+			glDeleteRenderbuffers(1, &colorBuffer);
+			glDeleteRenderbuffers(1, &depthBuffer);
+		}
+		fbo = colorBuffer = depthBuffer = 0;
+	}
+
+	void bind() const {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glViewport(0, 0, width, height);
+	}
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+};
+
+// an image read back from the gpu, rows bottom up as gl returns them
+struct FrameImage {
+	int index;
+	int width;
+	int height;
+	vector<unsigned char> rgba;
+};
+
+// writes numbered binary ppm files on a background thread
+class FrameWriter {
+private:
+	string pattern; // printf pattern with one integer, e.g. "out/frame_%06d.ppm"
+	thread worker;
+	mutex lock;
+	condition_variable changed;
+	deque<FrameImage> queue;
+	vector<FrameImage> spare; // images whose buffers can be reused
+	bool stopping;
+	bool failed;
+
+	void run() {
+		vector<unsigned char> row;
+		while (true) {
+			FrameImage image;
+			{
+				unique_lock<mutex> guard(lock);
+				changed.wait(guard, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) {
+					return;
+				}
+				image = move(queue.front());
+				queue.pop_front();
+			}
+			changed.notify_all();
+
+			char path[1024];
+			snprintf(path, sizeof(path), pattern.c_str(), image.index);
+			FILE* file = fopen(path, "wb");
+			bool ok = file != nullptr;
+			if (ok) {
+				fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+				row.resize(image.width * 3);
+				// ppm rows go top down
+				for (int y = image.height - 1; y >= 0 && ok; y--) {
+					const unsigned char* src = image.rgba.data() + (size_t)y * image.width * 4;
+					for (int x = 0; x < image.width; x++) {
+						row[x * 3] = src[x * 4];
+						row[x * 3 + 1] = src[x * 4 + 1];
+						row[x * 3 + 2] = src[x * 4 + 2];
+					}
+					ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+				}
+				ok = fclose(file) == 0 && ok;
+			}
+			lock_guard<mutex> guard(lock);
+			if (!ok && !failed) {
+				cout << "ERROR: FRAME " << path << " UNABLE TO WRITE!" << endl;
+				failed = true;
+			}
+			spare.push_back(move(image));
+		}
+	}
+
+public:
+	FrameWriter() : stopping(false), failed(false) {}
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	~FrameWriter() {
+		close();
+	}
+
+	void open(const string& filePattern) {
+		close();
+		pattern = filePattern;
+		stopping = false;
+		failed = false;
+		worker = thread([this]() { run(); });
+	}
+
+	// an image to fill, with the storage of an already written one when possible
+	FrameImage acquire() {
+		lock_guard<mutex> guard(lock);
+		if (spare.empty()) {
+			return FrameImage();
+		}
+		FrameImage image = move(spare.back());
+		spare.pop_back();
+		return image;
+	}
+
+	// hand an image over, blocks while the writer is MAX_QUEUED_IMAGES behind
+	void write(FrameImage& image) {
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this]() { return (int)queue.size() < MAX_QUEUED_IMAGES; });
+		queue.push_back(move(image));
+		guard.unlock();
+		changed.notify_all();
+	}
+
+	// write everything queued and stop the worker
+	void close() {
+		if (!worker.joinable()) {
+			return;
+		}
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		changed.notify_all();
+		worker.join();
+	}
+
+	bool hasFailed() {
+		lock_guard<mutex> guard(lock);
+		return failed;
+	}
+};
+
+// reads frames back through two pixel pack buffers used in turn
+class FrameCapture {
+private:
+	unsigned int pbo[2];
+	GLsync fences[2];
+	int frameOf[2]; // the frame each buffer holds, -1 for none
+	int next; // the buffer the next frame goes to
+	int width;
+	int height;
+	FrameWriter writer;
+
+	// wait for a pending readback and hand its pixels to the writer
+	void collect(int b) {
+		if (frameOf[b] < 0) {
+			return;
+		}
+		glClientWaitSync(fences[b], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fences[b]);
+		fences[b] = 0;
+
+		FrameImage image = writer.acquire();
+		image.index = frameOf[b];
+		image.width = width;
+		image.height = height;
+		image.rgba.resize((size_t)width * height * 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[b]);
+		const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image.rgba.size(), GL_MAP_READ_BIT);
+		if (pixels != nullptr) {
+			memcpy(image.rgba.data(), pixels, image.rgba.size());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		frameOf[b] = -1;
+		if (pixels == nullptr) {
+			cout << "ERROR: FRAME UNABLE TO READ BACK!" << endl;
+			return;
+		}
+		writer.write(image);
+	}
+
+public:
+	FrameCapture() : next(0), width(0), height(0) {
+		pbo[0] = pbo[1] = 0;
+		fences[0] = fences[1] = 0;
+		frameOf[0] = frameOf[1] = -1;
+	}
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	~FrameCapture() {
+		release();
+	}
+
+	// frames are written to files named by a printf pattern of the frame index
+	void init(int captureWidth, int captureHeight, const string& filePattern) {
+		width = captureWidth;
+		height = captureHeight;
+		glGenBuffers(2, pbo);
+		for (int b = 0; b < 2; b++) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[b]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		writer.open(filePattern);
+	}
+
+	// start reading back the bound read framebuffer, then collect the previous frame
+	void capture(int frame) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[next]);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frameOf[next] = frame;
+		next = 1 - next;
+		collect(next);
+	}
+
+	// collect the last frames and wait until every file is written
+	// returns whether all of them were
+	bool finish() {
+		collect(next);
+		collect(1 - next);
+		writer.close();
+		return !writer.hasFailed();
+	}
+
+	void release() {
+		if (pbo[0] != 0) {
+			for (int b = 0; b < 2; b++) {
+				if (fences[b] != 0) {
+					glDeleteSync(fences[b]);
+				}
+				fences[b] = 0;
+				frameOf[b] = -1;
+			}
+			glDeleteBuffers(2, pbo);
+		}
+		pbo[0] = pbo[1] = 0;
+		writer.close();
+	}
+};
+
+#endif
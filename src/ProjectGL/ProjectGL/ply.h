@@ -0,0 +1,769 @@
+// a reader of PLY meshes (ascii, binary_little_endian and binary_big_endian)
+// reference: Greg Turk, "The PLY Polygon File Format", 1994
+// the file is mapped instead of read, the x, y, z and every other scalar property of
+// the vertices are kept, and polygons are split into triangle fans
+// ascii bodies are split into chunks at line boundaries and parsed by several threads
+// with a number parser that does not go through the locale aware strtod
+// PlyPointReader streams just the vertex positions of files too large for a Mesh
+
+#ifndef PLY_H
+#define PLY_H
+
+#include "mesh.h"
+#include "mapped_file.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+enum PlyFormat {
+	PLY_ASCII, PLY_BINARY_LE, PLY_BINARY_BE
+};
+
+enum PlyType {
+	PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_NO_TYPE
+};
+
+struct PlyProperty {
+	string name;
+	PlyType type; // of the values
+	PlyType countType; // of the length of a list, PLY_NO_TYPE for a scalar
+};
+
+struct PlyElement {
+	string name;
+	size_t count;
+	vector<PlyProperty> properties;
+};
+
+struct PlyHeader {
+	PlyFormat format;
+	vector<PlyElement> elements;
+	size_t bodyOffset; // of the first byte after end_header
+};
+
+// ascii bodies smaller than this are parsed by one thread
+const size_t PLY_MIN_CHUNK = 256 * 1024;
+
+inline PlyType plyTypeOf(const string& name) {
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	return PLY_NO_TYPE;
+}
+
+inline size_t plyTypeSize(PlyType type) {
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+	return sizes[type];
+}
+
+// parse the header, return false if it is not a header this reader understands
+inline bool parsePlyHeader(const char* begin, const char* end, PlyHeader& header) {
+	header.elements.clear();
+	header.bodyOffset = 0;
+	const char* p = begin;
+	bool first = true, hasFormat = false;
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == nullptr) {
+			return false;
+		}
+		string line(p, eol);
+		p = eol + 1;
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		stringstream in(line);
+		string keyword;
+		in >> keyword;
+		if (first) {
+			if (keyword != "ply") {
+				return false;
+			}
+			first = false;
+		}
+		else if (keyword == "format") {
+			string format, version;
+			in >> format >> version;
+			if (format == "ascii") header.format = PLY_ASCII;
+			else if (format == "binary_little_endian") header.format = PLY_BINARY_LE;
+			else if (format == "binary_big_endian") header.format = PLY_BINARY_BE;
+			else return false;
+			hasFormat = true;
+		}
+		else if (keyword == "element") {
+			PlyElement element;
+			if (!(in >> element.name >> element.count)) {
+				return false;
+			}
+			header.elements.push_back(element);
+		}
+		else if (keyword == "property") {
+			if (header.elements.empty()) {
+				return false;
+			}
+			PlyProperty property;
+			string type;
+			in >> type;
+			if (type == "list") {
+				string countType, valueType;
+				in >> countType >> valueType;
+				property.countType = plyTypeOf(countType);
+				property.type = plyTypeOf(valueType);
+				if (property.countType == PLY_NO_TYPE || property.countType >= PLY_FLOAT32) {
+					return false;
+				}
+			}
+			else {
+				property.countType = PLY_NO_TYPE;
+				property.type = plyTypeOf(type);
+			}
+			if (property.type == PLY_NO_TYPE || !(in >> property.name)) {
+				return false;
+			}
+			header.elements.back().properties.push_back(property);
+		}
+		else if (keyword == "end_header") {
+			header.bodyOffset = p - begin;
+			return hasFormat;
+		}
+		// comment, obj_info and unknown lines are skipped
+	}
+	return false;
+}
+
+// numbers of an ascii body
+
+inline const char* skipPlySpace(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		p++;
+	}
+	return p;
+}
+
+// a decimal number with optional fraction and exponent, returns null if there is none
+// anything unusual (inf, nan, more than 64 characters) goes through strtod
+inline const char* parsePlyNumber(const char* p, const char* end, double& value) {
+	static const double POW10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	p = skipPlySpace(p, end);
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	const char* digitsStart = p;
+	for (; p < end && (unsigned)(*p - '0') < 10; p++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && (unsigned)(*p - '0') < 10; p++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (p == digitsStart || (p == digitsStart + 1 && *digitsStart == '.')) {
+		p = start;
+	}
+	else if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			negativeExponent = *q == '-';
+			q++;
+		}
+		int e = 0;
+		const char* exponentStart = q;
+		for (; q < end && (unsigned)(*q - '0') < 10; q++) {
+			e = std::min(e * 10 + (*q - '0'), 100000);
+		}
+		if (q == exponentStart) {
+			p = start;
+		}
+		else {
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+	if (p != start && (p == end || (unsigned char)*p <= ' ')) {
+		double v = (double)mantissa;
+		if (exponent < 0) {
+			v = -exponent <= 22 ? v / POW10[-exponent] : v * pow(10.0, exponent);
+		}
+		else if (exponent > 0) {
+			v = exponent <= 22 ? v * POW10[exponent] : v * pow(10.0, exponent);
+		}
+		value = negative ? -v : v;
+		return p;
+	}
+	// not a plain decimal, let the library try
+	char buffer[65];
+	size_t n = 0;
+	for (p = start; p < end && (unsigned char)*p > ' ' && n < 64; p++) {
+		buffer[n++] = *p;
+	}
+	buffer[n] = 0;
+	char* stop;
+	value = strtod(buffer, &stop);
+	return stop == buffer ? nullptr : start + (stop - buffer);
+}
+
+// reading one element of the body, the same for ascii and binary
+
+// where each property of a vertex goes: 0, 1, 2 for x, y, z, 3 + k for the k-th extra
+// property of the mesh and -1 for lists, which are skipped
+inline vector<int> plyVertexTargets(const PlyElement& element, Mesh& mesh) {
+	vector<int> targets;
+	for (auto& property : element.properties) {
+		if (property.countType != PLY_NO_TYPE) {
+			targets.push_back(-1);
+		}
+		else if (property.name == "x" || property.name == "y" || property.name == "z") {
+			targets.push_back(property.name[0] - 'x');
+		}
+		else {
+			targets.push_back(3 + (int)mesh.properties.size());
+			MeshProperty extra;
+			extra.name = property.name;
+			mesh.properties.push_back(extra);
+		}
+	}
+	return targets;
+}
+
+// the list property holding the corners of a face, -1 if there is none
+inline int plyFaceIndexProperty(const PlyElement& element) {
+	for (size_t i = 0; i < element.properties.size(); i++) {
+		const PlyProperty& property = element.properties[i];
+		if (property.countType != PLY_NO_TYPE && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+inline void storePlyVertexValue(Mesh& mesh, int target, size_t vertex, float value) {
+	if (target == 0) mesh.x[vertex] = value;
+	else if (target == 1) mesh.y[vertex] = value;
+	else if (target == 2) mesh.z[vertex] = value;
+	else if (target > 2) mesh.properties[target - 3].values[vertex] = value;
+}
+
+// the vertex a face corner refers to, UINT32_MAX if it is not one of numVertices, checked
+// before the conversion since a value out of the range of uint32_t would be undefined
+inline uint32_t plyCornerIndex(double value, size_t numVertices) {
+	return value >= 0 && value < (double)std::min(numVertices, (size_t)UINT32_MAX) ? (uint32_t)value : UINT32_MAX;
+}
+
+// split a polygon into a fan of triangles, false if a corner is not a vertex
+inline bool addPlyPolygon(const uint32_t* corners, size_t count, size_t numVertices, vector<uint32_t>& indices) {
+	for (size_t i = 0; i < count; i++) {
+		if (corners[i] >= numVertices) {
+			return false;
+		}
+	}
+	for (size_t i = 2; i < count; i++) {
+		indices.push_back(corners[0]);
+		indices.push_back(corners[i - 1]);
+		indices.push_back(corners[i]);
+	}
+	return true;
+}
+
+// ascii bodies, one element per line
+
+struct PlyChunk {
+	const char* begin;
+	const char* end;
+	size_t firstLine;
+	vector<uint32_t> indices; // of the faces in this chunk
+	bool ok;
+};
+
+// parse the lines of one chunk, lines belong to the elements in the order of the header
+inline void parsePlyChunk(PlyChunk& chunk, const PlyHeader& header, const vector<int>& vertexTargets,
+	int vertexElement, int faceElement, int faceProperty, Mesh& mesh) {
+	chunk.ok = true;
+	size_t line = chunk.firstLine;
+	size_t numVertices = mesh.numVertices();
+	vector<uint32_t> corners;
+
+	// the element holding the current line and the line its records start at
+	size_t element = 0, elementStart = 0;
+	const char* p = chunk.begin;
+	while (p < chunk.end && chunk.ok) {
+		const char* eol = (const char*)memchr(p, '\n', chunk.end - p);
+		if (eol == nullptr) {
+			eol = chunk.end;
+		}
+		while (element < header.elements.size() && line >= elementStart + header.elements[element].count) {
+			elementStart += header.elements[element].count;
+			element++;
+		}
+		if (element == header.elements.size()) {
+			// past the last element, only blank lines are allowed
+			chunk.ok = skipPlySpace(p, eol) == eol;
+		}
+		else if ((int)element == vertexElement || (int)element == faceElement) {
+			size_t record = line - elementStart;
+			const vector<PlyProperty>& properties = header.elements[element].properties;
+			const char* q = p;
+			for (size_t i = 0; i < properties.size() && chunk.ok; i++) {
+				double value;
+				if (properties[i].countType == PLY_NO_TYPE) {
+					q = parsePlyNumber(q, eol, value);
+					chunk.ok = q != nullptr;
+					if (chunk.ok && (int)element == vertexElement) {
+						storePlyVertexValue(mesh, vertexTargets[i], record, (float)value);
+					}
+					continue;
+				}
+				double count;
+				q = parsePlyNumber(q, eol, count);
+				// every value takes at least a character, which also keeps a huge count from the
+				// conversion below
+				chunk.ok = q != nullptr && count >= 0 && count <= eol - q;
+				bool keep = (int)element == faceElement && (int)i == faceProperty;
+				corners.clear();
+				for (long long c = 0; chunk.ok && c < (long long)count; c++) {
+					q = parsePlyNumber(q, eol, value);
+					chunk.ok = q != nullptr;
+					if (keep) {
+						corners.push_back(plyCornerIndex(value, numVertices));
+					}
+				}
+				if (chunk.ok && keep) {
+					chunk.ok = addPlyPolygon(corners.data(), corners.size(), numVertices, chunk.indices);
+				}
+			}
+		}
+		p = eol + 1;
+		line++;
+	}
+}
+
+// run work(c) for every chunk c, spread over the hardware threads
+template <typename F>
+void forPlyChunks(int numChunks, const F& work) {
+	int numThreads = std::max(1, std::min(numChunks, (int)thread::hardware_concurrency()));
+	if (numThreads == 1) {
+		for (int c = 0; c < numChunks; c++) {
+			work(c);
+		}
+		return;
+	}
+	vector<thread> workers;
+	for (int t = 0; t < numThreads; t++) {
+		workers.push_back(thread([t, numThreads, numChunks, &work]() {
+			for (int c = t; c < numChunks; c += numThreads) {
+				work(c);
+			}
+		}));
+	}
+	for (auto& w : workers) {
+		w.join();
+	}
+}
+
+inline bool readPlyAscii(const char* body, const char* end, const PlyHeader& header, const vector<int>& vertexTargets,
+	int vertexElement, int faceElement, int faceProperty, Mesh& mesh) {
+	// chunks end right after a newline so no line is split
+	size_t size = end - body;
+	int numChunks = (int)std::max((size_t)1, std::min((size_t)std::max(1u, thread::hardware_concurrency()) * 4, size / PLY_MIN_CHUNK));
+	vector<PlyChunk> chunks(numChunks);
+	const char* p = body;
+	for (int c = 0; c < numChunks; c++) {
+		chunks[c].begin = p;
+		const char* q = c == numChunks - 1 ? end : body + size * (c + 1) / numChunks;
+		if (q < p) {
+			q = p;
+		}
+		const char* eol = q < end ? (const char*)memchr(q, '\n', end - q) : nullptr;
+		p = eol == nullptr || c == numChunks - 1 ? end : eol + 1;
+		chunks[c].end = p;
+	}
+
+	// the first line of every chunk, from the newlines of the chunks before it
+	vector<size_t> newlines(numChunks, 0);
+	forPlyChunks(numChunks, [&](int c) {
+		size_t n = 0;
+		for (const char* q = chunks[c].begin; q < chunks[c].end; q++) {
+			q = (const char*)memchr(q, '\n', chunks[c].end - q);
+			if (q == nullptr) {
+				break;
+			}
+			n++;
+		}
+		newlines[c] = n;
+	});
+	size_t line = 0;
+	for (int c = 0; c < numChunks; c++) {
+		chunks[c].firstLine = line;
+		line += newlines[c];
+	}
+	size_t records = 0;
+	for (auto& element : header.elements) {
+		records += element.count;
+	}
+	// the last line may lack its newline
+	if (line + (size && end[-1] != '\n') < records) {
+		cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+		return false;
+	}
+
+	forPlyChunks(numChunks, [&](int c) {
+		parsePlyChunk(chunks[c], header, vertexTargets, vertexElement, faceElement, faceProperty, mesh);
+	});
+	size_t numIndices = 0;
+	for (auto& chunk : chunks) {
+		if (!chunk.ok) {
+			cout << "ERROR: PLY FILE HAS A BAD LINE!" << endl;
+			return false;
+		}
+		numIndices += chunk.indices.size();
+	}
+	mesh.indices.reserve(numIndices);
+	for (auto& chunk : chunks) {
+		mesh.indices.insert(mesh.indices.end(), chunk.indices.begin(), chunk.indices.end());
+	}
+	return true;
+}
+
+// binary bodies
+
+// one value of the given type, converted to double, false past the end of the body
+inline bool readPlyBinary(const char*& p, const char* end, PlyType type, bool swap, double& value) {
+	size_t size = plyTypeSize(type);
+	if ((size_t)(end - p) < size) {
+		return false;
+	}
+	unsigned char bytes[8];
+	memcpy(bytes, p, size);
+	if (swap) {
+		std::reverse(bytes, bytes + size);
+	}
+	p += size;
+	switch (type) {
+	case PLY_INT8: value = *(int8_t*)bytes; break;
+	case PLY_UINT8: value = *(uint8_t*)bytes; break;
+	case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); value = v; break; }
+	case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); value = v; break; }
+	case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); value = v; break; }
+	case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); value = v; break; }
+	case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); value = v; break; }
+	default: { double v; memcpy(&v, bytes, 8); value = v; break; }
+	}
+	return true;
+}
+
+inline bool readPlyBinaryBody(const char* body, const char* end, const PlyHeader& header, const vector<int>& vertexTargets,
+	int vertexElement, int faceElement, int faceProperty, Mesh& mesh) {
+	uint32_t one = 1;
+	bool littleEndian = *(const char*)&one == 1;
+	bool swap = littleEndian != (header.format == PLY_BINARY_LE);
+	size_t numVertices = mesh.numVertices();
+	vector<uint32_t> corners;
+	const char* p = body;
+	for (size_t e = 0; e < header.elements.size(); e++) {
+		const PlyElement& element = header.elements[e];
+		bool isVertex = (int)e == vertexElement;
+		bool isFace = (int)e == faceElement;
+
+		// elements of scalars only have a fixed size, skip them at once
+		size_t recordSize = 0;
+		for (auto& property : element.properties) {
+			recordSize = property.countType == PLY_NO_TYPE && recordSize != SIZE_MAX ? recordSize + plyTypeSize(property.type) : SIZE_MAX;
+		}
+		if (!isVertex && !isFace && recordSize != SIZE_MAX) {
+			if ((size_t)(end - p) / std::max(recordSize, (size_t)1) < element.count) {
+				cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+				return false;
+			}
+			p += recordSize * element.count;
+			continue;
+		}
+
+		for (size_t r = 0; r < element.count; r++) {
+			for (size_t i = 0; i < element.properties.size(); i++) {
+				const PlyProperty& property = element.properties[i];
+				double value;
+				if (property.countType == PLY_NO_TYPE) {
+					if (!readPlyBinary(p, end, property.type, swap, value)) {
+						cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+						return false;
+					}
+					if (isVertex) {
+						storePlyVertexValue(mesh, vertexTargets[i], r, (float)value);
+					}
+					continue;
+				}
+				double count;
+				if (!readPlyBinary(p, end, property.countType, swap, count) || count < 0 || count > end - p) {
+					cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+					return false;
+				}
+				bool keep = isFace && (int)i == faceProperty;
+				if (!keep) {
+					size_t skip = (size_t)count * plyTypeSize(property.type);
+					if ((size_t)(end - p) < skip) {
+						cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+						return false;
+					}
+					p += skip;
+					continue;
+				}
+				corners.resize((size_t)count);
+				for (size_t c = 0; c < corners.size(); c++) {
+					if (!readPlyBinary(p, end, property.type, swap, value)) {
+						cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+						return false;
+					}
+					corners[c] = plyCornerIndex(value, numVertices);
+				}
+				if (!addPlyPolygon(corners.data(), corners.size(), numVertices, mesh.indices)) {
+					cout << "ERROR: PLY FACE HAS A BAD VERTEX INDEX!" << endl;
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// load the vertices and faces of a PLY file, return false and leave the mesh empty on failure
+inline bool loadPly(const char* path, Mesh& mesh) {
+	mesh.clear();
+	MappedFile file;
+	if (!file.open(path)) {
+		cout << "ERROR: PLY FILE " << path << " UNABLE TO LOAD!" << endl;
+		return false;
+	}
+	PlyHeader header;
+	if (!parsePlyHeader(file.begin(), file.end(), header)) {
+		cout << "ERROR: PLY FILE " << path << " HAS A BAD HEADER!" << endl;
+		return false;
+	}
+
+	int vertexElement = -1, faceElement = -1, faceProperty = -1;
+	for (size_t e = 0; e < header.elements.size(); e++) {
+		if (header.elements[e].name == "vertex" && vertexElement < 0) {
+			vertexElement = (int)e;
+		}
+		else if (header.elements[e].name == "face" && faceElement < 0) {
+			faceElement = (int)e;
+			faceProperty = plyFaceIndexProperty(header.elements[e]);
+		}
+	}
+	if (vertexElement < 0) {
+		cout << "ERROR: PLY FILE " << path << " HAS NO VERTICES!" << endl;
+		return false;
+	}
+	vector<int> vertexTargets = plyVertexTargets(header.elements[vertexElement], mesh);
+	mesh.resizeVertices(header.elements[vertexElement].count);
+	if (faceElement >= 0) {
+		mesh.indices.reserve(header.elements[faceElement].count * 3);
+	}
+
+	const char* body = file.begin() + header.bodyOffset;
+	bool ok = header.format == PLY_ASCII ?
+		readPlyAscii(body, file.end(), header, vertexTargets, vertexElement, faceElement, faceProperty, mesh) :
+		readPlyBinaryBody(body, file.end(), header, vertexTargets, vertexElement, faceElement, faceProperty, mesh);
+	if (!ok) {
+		cout << "ERROR: PLY FILE " << path << " UNABLE TO PARSE!" << endl;
+		mesh.clear();
+	}
+	return ok;
+}
+
+// reads only the x, y and z of the vertices, a block at a time, for point clouds too large
+// to load at once, the file stays mapped and the pages behind the reader can be dropped by the os
+class PlyPointReader {
+private:
+	MappedFile file;
+	PlyHeader header;
+	int vertexElement;
+	int coordinate[3]; // the properties holding x, y and z
+	bool swap;
+	const char* vertices; // the first vertex record
+	const char* p;
+	size_t next; // the vertex p is at
+
+	// skip the records of one element, false if the body ends first
+	bool skipElement(const char*& q, const PlyElement& element) const {
+		const char* end = file.end();
+		for (size_t r = 0; r < element.count; r++) {
+			if (header.format == PLY_ASCII) {
+				q = (const char*)memchr(q, '\n', end - q);
+				if (q == nullptr) {
+					return false;
+				}
+				q++;
+				continue;
+			}
+			for (auto& property : element.properties) {
+				double count = 1.0;
+				if (property.countType != PLY_NO_TYPE && !readPlyBinary(q, end, property.countType, swap, count)) {
+					return false;
+				}
+				size_t skip = (size_t)std::max(count, 0.0) * plyTypeSize(property.type);
+				if ((size_t)(end - q) < skip) {
+					return false;
+				}
+				q += skip;
+			}
+		}
+		return true;
+	}
+
+	// one vertex, false if it is malformed or past the end of the body
+	bool readVertex(vec3& point) {
+		const char* end = file.end();
+		const PlyElement& element = header.elements[vertexElement];
+		double values[3] = { 0.0, 0.0, 0.0 };
+		if (header.format == PLY_ASCII) {
+			const char* eol = (const char*)memchr(p, '\n', end - p);
+			if (eol == nullptr) {
+				eol = end;
+			}
+			const char* q = p;
+			for (size_t i = 0; i < element.properties.size() && q != nullptr; i++) {
+				double value;
+				q = parsePlyNumber(q, eol, value);
+				if (q != nullptr && element.properties[i].countType != PLY_NO_TYPE) {
+					for (int c = 0; c < (int)value && q != nullptr; c++) {
+						q = parsePlyNumber(q, eol, value);
+					}
+					continue;
+				}
+				for (int k = 0; k < 3; k++) {
+					if (coordinate[k] == (int)i) {
+						values[k] = value;
+					}
+				}
+			}
+			p = eol < end ? eol + 1 : end;
+			if (q == nullptr) {
+				return false;
+			}
+		}
+		else {
+			for (size_t i = 0; i < element.properties.size(); i++) {
+				const PlyProperty& property = element.properties[i];
+				double value;
+				if (property.countType != PLY_NO_TYPE) {
+					if (!readPlyBinary(p, end, property.countType, swap, value) || value < 0 || (size_t)(end - p) < (size_t)value * plyTypeSize(property.type)) {
+						return false;
+					}
+					p += (size_t)value * plyTypeSize(property.type);
+					continue;
+				}
+				if (!readPlyBinary(p, end, property.type, swap, value)) {
+					return false;
+				}
+				for (int k = 0; k < 3; k++) {
+					if (coordinate[k] == (int)i) {
+						values[k] = value;
+					}
+				}
+			}
+		}
+		point = vec3((float)values[0], (float)values[1], (float)values[2]);
+		return true;
+	}
+
+public:
+	PlyPointReader() : vertexElement(-1), swap(false), vertices(nullptr), p(nullptr), next(0) {
+		coordinate[0] = coordinate[1] = coordinate[2] = -1;
+	}
+
+	bool open(const char* path) {
+		vertexElement = -1;
+		if (!file.open(path)) {
+			cout << "ERROR: PLY FILE " << path << " UNABLE TO LOAD!" << endl;
+			return false;
+		}
+		if (!parsePlyHeader(file.begin(), file.end(), header)) {
+			cout << "ERROR: PLY FILE " << path << " HAS A BAD HEADER!" << endl;
+			return false;
+		}
+		uint32_t one = 1;
+		swap = (*(const char*)&one == 1) != (header.format == PLY_BINARY_LE);
+		const char* q = file.begin() + header.bodyOffset;
+		for (size_t e = 0; e < header.elements.size() && vertexElement < 0; e++) {
+			if (header.elements[e].name != "vertex") {
+				if (!skipElement(q, header.elements[e])) {
+					cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+					return false;
+				}
+				continue;
+			}
+			vertexElement = (int)e;
+			const vector<PlyProperty>& properties = header.elements[e].properties;
+			for (size_t i = 0; i < properties.size(); i++) {
+				if (properties[i].countType == PLY_NO_TYPE && properties[i].name.size() == 1 && properties[i].name[0] >= 'x' && properties[i].name[0] <= 'z') {
+					coordinate[properties[i].name[0] - 'x'] = (int)i;
+				}
+			}
+		}
+		if (vertexElement < 0) {
+			cout << "ERROR: PLY FILE " << path << " HAS NO VERTICES!" << endl;
+			return false;
+		}
+		vertices = q;
+		rewind();
+		return true;
+	}
+
+	size_t count() const {
+		return vertexElement < 0 ? 0 : header.elements[vertexElement].count;
+	}
+
+	void rewind() {
+		p = vertices;
+		next = 0;
+	}
+
+	// read up to max points, return how many were read, fewer only at the end or on an error
+	size_t read(vec3* points, size_t max) {
+		size_t n = 0;
+		while (n < max && next < count()) {
+			if (!readVertex(points[n])) {
+				cout << "ERROR: PLY FILE IS TRUNCATED!" << endl;
+				next = count();
+				break;
+			}
+			n++;
+			next++;
+		}
+		return n;
+	}
+};
+
+#endif
@@ -0,0 +1,771 @@
+// an octree over the vertices of a scan too large for memory, built by streaming the points
+// from the PLY file and kept in a paged file next to it, model.ply.pcache
+// the build reads the file three times: once for the bounds, once to count the points in a
+// fine grid, from which the tree is shaped so no leaf holds more than POINT_NODE_CAPACITY
+// points, and once to sort the points into their leaves through a bucket file, which is
+// filled a buffer at a time so memory stays bounded whatever the size of the scan
+// the leaves of the grid that are still too full are split further by sorting only their
+// points again, and the leaves are copied to the paged file a block at a time
+// the leaves hold all the points, an inner node one point of each cell of a coarse grid
+// over its box, picked from its children, so the tree can be drawn at any level of detail
+// the points of every node start on a page of their own in the paged file, and the loader
+// copies the nodes it needs out of the mapped file, nearest and coarsest first, until the
+// memory budget is spent, evicting the ones used least recently
+// reference: Markus Schutz, "Potree: Rendering Large Point Clouds in Web Browsers", 2016
+
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include "ply.h"
+#include "mesh_cache.h"
+#include "triangle.h"
+#include "mapped_file.h"
+#include <vector>
+#include <queue>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const char POINT_CLOUD_MAGIC[8] = { 'P', 'O', 'I', 'N', 'T', 'C', 'L', 'D' };
+const uint32_t POINT_CLOUD_VERSION = 2; // raise when the layout or the builder changes
+const char POINT_CLOUD_SUFFIX[] = ".pcache";
+const int POINT_GRID_LEVELS = 7; // the counting grid has 2^7 cells a side
+const int POINT_MAX_LEVEL = 20; // the leaves of the counting grid that are too full are split down to this level
+const uint32_t POINT_NODE_CAPACITY = 65536; // a node with more points is split
+const int POINT_SAMPLE_GRID = 32; // an inner node keeps one point of each cell of a grid this fine
+const size_t POINT_READ_BLOCK = 1 << 16; // points read from the source at once
+const size_t POINT_BUILD_BUFFER = 64 << 20; // bytes of points sorted in memory before they go to the bucket file
+const size_t POINT_CLOUD_LOAD_BYTES = 16 << 20; // one update loads at most this much
+const float POINT_CLOUD_DETAIL = 0.004f; // the spacing of the points drawn, in radians seen from the eye
+
+struct PointCloudHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t endianTag;
+	MeshSource source;
+	uint64_t numPoints;
+	uint64_t numNodes;
+	uint64_t fileSize;
+	vec3 minPos; // of the cube around the points
+	float size;
+	vec3 pointsMin; // of the box around the points
+	vec3 pointsMax;
+};
+
+// the nodes are stored breadth first, so the children of a node are next to each other
+struct PointNode {
+	vec3 minPos;
+	float size; // of the cube
+	uint64_t offset; // of the points in the file
+	uint32_t count;
+	uint32_t firstChild;
+	uint32_t childMask; // bit k is set if the child in octant k (x + 2y + 4z) exists, 0 for a leaf
+	uint32_t level;
+};
+
+static_assert(sizeof(PointNode) == 40, "PointNode is written to files as it is");
+
+// the index of the child in octant k among the children of node
+inline uint32_t pointChild(const PointNode& node, int k) {
+	uint32_t below = node.childMask & ((1u << k) - 1);
+	uint32_t rank = 0;
+	for (; below != 0; below &= below - 1) {
+		rank++;
+	}
+	return node.firstChild + rank;
+}
+
+class PointCloudBuilder {
+private:
+	struct Block {
+		uint64_t offset; // in the bucket file
+		uint32_t count;
+		uint32_t file; // the round of the sort that wrote it
+	};
+
+	// the point nearest to the center of each cell of a grid over the cube of a node
+	struct PointSampler {
+		vec3 minPos;
+		float cellSize;
+		vector<vec3> best;
+		vector<float> bestDistance;
+
+		explicit PointSampler(const PointNode& node) :
+			minPos(node.minPos), cellSize(node.size / POINT_SAMPLE_GRID),
+			best(POINT_SAMPLE_GRID * POINT_SAMPLE_GRID * POINT_SAMPLE_GRID),
+			bestDistance(best.size(), INFINITY) {}
+
+		void add(const vec3* points, size_t count) {
+			for (size_t i = 0; i < count; i++) {
+				const vec3& p = points[i];
+				ivec3 c = glm::clamp(ivec3((p - minPos) / cellSize), ivec3(0), ivec3(POINT_SAMPLE_GRID - 1));
+				vec3 d = p - (minPos + (vec3(c) + 0.5f) * cellSize);
+				size_t index = ((size_t)c.z * POINT_SAMPLE_GRID + c.y) * POINT_SAMPLE_GRID + c.x;
+				if (dot(d, d) < bestDistance[index]) {
+					bestDistance[index] = dot(d, d);
+					best[index] = p;
+				}
+			}
+		}
+
+		void take(vector<vec3>& sample) const {
+			sample.clear();
+			for (size_t c = 0; c < best.size(); c++) {
+				if (bestDistance[c] < INFINITY) {
+					sample.push_back(best[c]);
+				}
+			}
+		}
+	};
+
+	PlyPointReader reader;
+	vector<vec3> readBuffer;
+	vec3 minPos;
+	float size;
+	vec3 lo, hi;
+	vector<PointNode> nodes;
+	vector<vector<Block> > blocks; // of each leaf in the bucket files
+	vector<vector<vec3> > buffers; // of each leaf, waiting to be spilled to the bucket file
+	size_t buffered;
+	string bucketPrefix;
+	FILE* bucketFile;
+	uint64_t bucketSize;
+	MappedFile buckets[POINT_MAX_LEVEL - POINT_GRID_LEVELS + 1]; // one file per round of the sort
+	int rounds;
+	FILE* out;
+	uint64_t written;
+
+	ivec3 cellOf(const vec3& p, int level) const {
+		int cells = 1 << level;
+		ivec3 c = ivec3((p - minPos) / size * (float)cells);
+		return glm::clamp(c, ivec3(0), ivec3(cells - 1));
+	}
+
+	static size_t cellIndex(const ivec3& c, int level) {
+		size_t cells = (size_t)1 << level;
+		return ((size_t)c.z * cells + c.y) * cells + c.x;
+	}
+
+	string bucketPath(int round) const {
+		return bucketPrefix + to_string(round) + ".tmp";
+	}
+
+	const vec3* blockPoints(const Block& b) const {
+		return (const vec3*)(buckets[b.file].begin() + b.offset);
+	}
+
+	uint64_t leafCount(uint32_t i) const {
+		uint64_t count = 0;
+		for (auto& b : blocks[i]) {
+			count += b.count;
+		}
+		return count;
+	}
+
+	bool beginRound() {
+		bucketFile = fopen(bucketPath(rounds).c_str(), "wb");
+		bucketSize = 0;
+		buffered = 0;
+		buffers.resize(nodes.size());
+		blocks.resize(nodes.size());
+		return bucketFile != nullptr;
+	}
+
+	// write out all the buffers, each as a block of its leaf
+	bool spill() {
+		bool ok = true;
+		for (size_t i = 0; i < buffers.size() && ok; i++) {
+			if (buffers[i].empty()) {
+				continue;
+			}
+			Block b = { bucketSize, (uint32_t)buffers[i].size(), (uint32_t)rounds };
+			size_t bytes = buffers[i].size() * sizeof(vec3);
+			ok = fwrite(buffers[i].data(), 1, bytes, bucketFile) == bytes;
+			bucketSize += bytes;
+			blocks[i].push_back(b);
+			vector<vec3>().swap(buffers[i]);
+		}
+		buffered = 0;
+		return ok;
+	}
+
+	bool bucket(uint32_t leaf, const vec3& p) {
+		buffers[leaf].push_back(p);
+		return ++buffered * sizeof(vec3) < POINT_BUILD_BUFFER || spill();
+	}
+
+	// map the file of the round so the next round and the writer can read it
+	bool endRound() {
+		bool ok = spill();
+		ok = fclose(bucketFile) == 0 && ok;
+		bucketFile = nullptr;
+		if (ok && bucketSize > 0) {
+			ok = buckets[rounds].open(bucketPath(rounds).c_str());
+		}
+		rounds++;
+		return ok;
+	}
+
+	// close the file of a round that failed, it is removed with the others
+	void abortRound() {
+		fclose(bucketFile);
+		bucketFile = nullptr;
+		rounds++;
+	}
+
+	// the leaves of the counting grid that are still over the capacity are split a level per
+	// round, their points sorted again into the children, until none is or they are too deep,
+	// which only a pile of the same point reaches
+	bool splitLeaves() {
+		while (rounds <= POINT_MAX_LEVEL - POINT_GRID_LEVELS) {
+			vector<uint32_t> full;
+			for (uint32_t i = 0; i < (uint32_t)nodes.size(); i++) {
+				if (nodes[i].childMask == 0 && nodes[i].level < (uint32_t)POINT_MAX_LEVEL && leafCount(i) > POINT_NODE_CAPACITY) {
+					full.push_back(i);
+				}
+			}
+			if (full.empty()) {
+				return true;
+			}
+			if (!beginRound()) {
+				return false;
+			}
+			for (uint32_t i : full) {
+				vec3 center = nodes[i].minPos + vec3(nodes[i].size * 0.5f);
+				uint64_t octants[8] = {};
+				for (auto& b : blocks[i]) {
+					const vec3* points = blockPoints(b);
+					for (uint32_t j = 0; j < b.count; j++) {
+						ivec3 side(glm::greaterThanEqual(points[j], center));
+						octants[side.x + 2 * side.y + 4 * side.z]++;
+					}
+				}
+				uint32_t childOf[8];
+				nodes[i].firstChild = (uint32_t)nodes.size();
+				for (int k = 0; k < 8; k++) {
+					if (octants[k] == 0) {
+						continue;
+					}
+					nodes[i].childMask |= 1u << k;
+					childOf[k] = (uint32_t)nodes.size();
+					PointNode child{};
+					child.size = nodes[i].size * 0.5f;
+					child.minPos = nodes[i].minPos + vec3(k & 1, (k >> 1) & 1, (k >> 2) & 1) * child.size;
+					child.level = nodes[i].level + 1;
+					nodes.push_back(child);
+				}
+				buffers.resize(nodes.size());
+				blocks.resize(nodes.size());
+				bool ok = true;
+				for (auto& b : blocks[i]) {
+					const vec3* points = blockPoints(b);
+					for (uint32_t j = 0; j < b.count && ok; j++) {
+						ivec3 side(glm::greaterThanEqual(points[j], center));
+						ok = bucket(childOf[side.x + 2 * side.y + 4 * side.z], points[j]);
+					}
+				}
+				vector<Block>().swap(blocks[i]);
+				if (!ok) {
+					abortRound();
+					return false;
+				}
+			}
+			if (!endRound()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool writeBytes(const void* data, size_t bytes) {
+		if (bytes > 0 && fwrite(data, 1, bytes, out) != bytes) {
+			return false;
+		}
+		written += bytes;
+		return true;
+	}
+
+	bool padToPage() {
+		static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+		return writeBytes(zeros, alignMeshCache((size_t)written) - (size_t)written);
+	}
+
+	// write the points of node i and its subtree, and hand the points that stand for the node
+	// to the sampler of its parent, a leaf is copied a block at a time out of the bucket files
+	bool writeNode(uint32_t i, PointSampler* parent) {
+		PointNode& node = nodes[i];
+		if (node.childMask == 0) {
+			if (!padToPage()) {
+				return false;
+			}
+			node.offset = written;
+			node.count = (uint32_t)leafCount(i);
+			for (auto& b : blocks[i]) {
+				const vec3* points = blockPoints(b);
+				if (!writeBytes(points, b.count * sizeof(vec3))) {
+					return false;
+				}
+				if (parent != nullptr) {
+					parent->add(points, b.count);
+				}
+			}
+			vector<Block>().swap(blocks[i]);
+			return true;
+		}
+		vector<vec3> sample;
+		{
+			PointSampler sampler(node);
+			for (int k = 0; k < 8; k++) {
+				if ((node.childMask & (1u << k)) && !writeNode(pointChild(node, k), &sampler)) {
+					return false;
+				}
+			}
+			sampler.take(sample);
+		}
+		if (!padToPage()) {
+			return false;
+		}
+		node.offset = written;
+		node.count = (uint32_t)sample.size();
+		if (parent != nullptr) {
+			parent->add(sample.data(), sample.size());
+		}
+		return writeBytes(sample.data(), sample.size() * sizeof(vec3));
+	}
+
+	void removeBuckets() {
+		for (int r = 0; r < rounds; r++) {
+			buckets[r].close();
+			remove(bucketPath(r).c_str());
+		}
+		rounds = 0;
+	}
+
+public:
+	PointCloudBuilder() : minPos(0.0f), size(1.0f), lo(0.0f), hi(0.0f), buffered(0), bucketFile(nullptr), bucketSize(0), rounds(0), out(nullptr), written(0) {}
+
+	// build the paged file of the vertices of a PLY file
+	bool build(const char* path, const MeshSource& source, const string& cachePath) {
+		if (!reader.open(path)) {
+			return false;
+		}
+		if (reader.count() == 0) {
+			cout << "ERROR: PLY FILE " << path << " HAS NO VERTICES!" << endl;
+			return false;
+		}
+		readBuffer.resize(POINT_READ_BLOCK);
+		size_t n;
+
+		// the cube around the points
+		lo = vec3(INFINITY);
+		hi = vec3(-INFINITY);
+		while ((n = reader.read(readBuffer.data(), readBuffer.size())) > 0) {
+			for (size_t i = 0; i < n; i++) {
+				lo = glm::min(lo, readBuffer[i]);
+				hi = glm::max(hi, readBuffer[i]);
+			}
+		}
+		vec3 extent = hi - lo;
+		size = std::max(extent.x, std::max(extent.y, extent.z));
+		size = size > 0.0f ? size * 1.0001f : 1.0f;
+		minPos = (lo + hi) * 0.5f - vec3(size * 0.5f);
+
+		// the points in each cell of every level
+		vector<vector<uint32_t> > counts(POINT_GRID_LEVELS + 1);
+		for (int level = 0; level <= POINT_GRID_LEVELS; level++) {
+			counts[level].assign((size_t)1 << (3 * level), 0);
+		}
+		reader.rewind();
+		while ((n = reader.read(readBuffer.data(), readBuffer.size())) > 0) {
+			for (size_t i = 0; i < n; i++) {
+				counts[POINT_GRID_LEVELS][cellIndex(cellOf(readBuffer[i], POINT_GRID_LEVELS), POINT_GRID_LEVELS)]++;
+			}
+		}
+		for (int level = POINT_GRID_LEVELS; level > 0; level--) {
+			int cells = 1 << level;
+			for (int z = 0; z < cells; z++) {
+				for (int y = 0; y < cells; y++) {
+					for (int x = 0; x < cells; x++) {
+						counts[level - 1][cellIndex(ivec3(x, y, z) / 2, level - 1)] += counts[level][cellIndex(ivec3(x, y, z), level)];
+					}
+				}
+			}
+		}
+
+		// shape the tree breadth first, the leaves own the finest cells below them
+		vector<ivec3> cellsOfNodes;
+		vector<uint32_t> leafOf(counts[POINT_GRID_LEVELS].size(), UINT32_MAX);
+		nodes.clear();
+		PointNode root{};
+		root.minPos = minPos;
+		root.size = size;
+		nodes.push_back(root);
+		cellsOfNodes.push_back(ivec3(0));
+		for (size_t i = 0; i < nodes.size(); i++) {
+			int level = (int)nodes[i].level;
+			ivec3 cell = cellsOfNodes[i];
+			if (counts[level][cellIndex(cell, level)] > POINT_NODE_CAPACITY && level < POINT_GRID_LEVELS) {
+				nodes[i].firstChild = (uint32_t)nodes.size();
+				for (int k = 0; k < 8; k++) {
+					ivec3 c = cell * 2 + ivec3(k & 1, (k >> 1) & 1, (k >> 2) & 1);
+					if (counts[level + 1][cellIndex(c, level + 1)] == 0) {
+						continue;
+					}
+					nodes[i].childMask |= 1u << k;
+					PointNode child{};
+					child.size = nodes[i].size * 0.5f;
+					child.minPos = minPos + vec3(c) * child.size;
+					child.level = level + 1;
+					nodes.push_back(child);
+					cellsOfNodes.push_back(c);
+				}
+				continue;
+			}
+			int span = 1 << (POINT_GRID_LEVELS - level);
+			ivec3 first = cell * span;
+			for (int z = 0; z < span; z++) {
+				for (int y = 0; y < span; y++) {
+					for (int x = 0; x < span; x++) {
+						leafOf[cellIndex(first + ivec3(x, y, z), POINT_GRID_LEVELS)] = (uint32_t)i;
+					}
+				}
+			}
+		}
+		counts.clear();
+
+		// sort the points into their leaves, spilling the buffers to the bucket file when full
+		string tmpPath = cachePath + ".tmp";
+		bucketPrefix = cachePath + ".points";
+		if (!beginRound()) {
+			cout << "ERROR: POINT CLOUD CACHE " << cachePath << " UNABLE TO WRITE!" << endl;
+			return false;
+		}
+		bool ok = true;
+		reader.rewind();
+		while (ok && (n = reader.read(readBuffer.data(), readBuffer.size())) > 0) {
+			for (size_t i = 0; i < n && ok; i++) {
+				ok = bucket(leafOf[cellIndex(cellOf(readBuffer[i], POINT_GRID_LEVELS), POINT_GRID_LEVELS)], readBuffer[i]);
+			}
+		}
+		if (ok) {
+			ok = endRound();
+		}
+		else {
+			abortRound();
+		}
+		leafOf.clear();
+		ok = ok && splitLeaves();
+		vector<vector<vec3> >().swap(buffers);
+
+		// the header and the nodes are written last, in front of the points
+		out = ok ? fopen(tmpPath.c_str(), "wb") : nullptr;
+		written = 0;
+		if (out != nullptr) {
+			vector<char> front(alignMeshCache(sizeof(PointCloudHeader) + nodes.size() * sizeof(PointNode)), 0);
+			ok = writeBytes(front.data(), front.size()) && writeNode(0, nullptr) && padToPage();
+			PointCloudHeader header{};
+			memcpy(header.magic, POINT_CLOUD_MAGIC, sizeof(header.magic));
+			header.version = POINT_CLOUD_VERSION;
+			header.endianTag = MESH_CACHE_ENDIAN_TAG;
+			header.source = source;
+			header.numPoints = reader.count();
+			header.numNodes = nodes.size();
+			header.fileSize = written;
+			header.minPos = minPos;
+			header.size = size;
+			header.pointsMin = lo;
+			header.pointsMax = hi;
+			ok = ok && fseek(out, 0, SEEK_SET) == 0 &&
+				fwrite(&header, sizeof(header), 1, out) == 1 &&
+				fwrite(nodes.data(), sizeof(PointNode), nodes.size(), out) == nodes.size();
+			ok = fclose(out) == 0 && ok;
+			out = nullptr;
+		}
+		else {
+			ok = false;
+		}
+		removeBuckets();
+		blocks.clear();
+		if (ok) {
+			// rename does not replace an existing file on windows
+			remove(cachePath.c_str());
+			ok = rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+		}
+		if (!ok) {
+			remove(tmpPath.c_str());
+			cout << "ERROR: POINT CLOUD CACHE " << cachePath << " UNABLE TO WRITE!" << endl;
+		}
+		return ok;
+	}
+};
+
+// the paged octree of a scan, with the nodes near the eye loaded into memory
+// not thread safe, the queries load the leaves they need as well
+class PointCloud {
+private:
+	MappedFile file;
+	const PointNode* nodes;
+	size_t nodeCount;
+	vector<vector<vec3> > resident;
+	vector<uint64_t> lastUse;
+	vector<uint64_t> wantedAt; // the last update that wanted each node
+	uint64_t clock; // counts the updates
+	uint64_t uses; // counts the uses of nodes, the order in which they are evicted
+	size_t residentBytes;
+	size_t budget; // of the last update, the queries keep to it too
+
+	bool openCache(const char* cachePath, const MeshSource& source) {
+		if (!file.open(cachePath)) {
+			return false;
+		}
+		const PointCloudHeader* h = (const PointCloudHeader*)file.begin();
+		bool valid = file.size() >= sizeof(PointCloudHeader) &&
+			memcmp(h->magic, POINT_CLOUD_MAGIC, sizeof(h->magic)) == 0 &&
+			h->version == POINT_CLOUD_VERSION &&
+			h->endianTag == MESH_CACHE_ENDIAN_TAG &&
+			h->fileSize == file.size() &&
+			h->source.size == source.size &&
+			h->source.time == source.time &&
+			h->source.hash == source.hash &&
+			h->numNodes > 0 && h->numNodes < UINT32_MAX &&
+			sizeof(PointCloudHeader) + h->numNodes * sizeof(PointNode) <= file.size();
+		const PointNode* table = (const PointNode*)(file.begin() + sizeof(PointCloudHeader));
+		for (uint64_t i = 0; valid && i < h->numNodes; i++) {
+			valid = table[i].offset + (uint64_t)table[i].count * sizeof(vec3) <= file.size() &&
+				(table[i].childMask == 0 || table[i].firstChild < h->numNodes);
+		}
+		if (!valid) {
+			file.close();
+			return false;
+		}
+		nodes = table;
+		nodeCount = (size_t)h->numNodes;
+		return true;
+	}
+
+	void load(uint32_t i) {
+		if (resident[i].empty() && nodes[i].count > 0) {
+			const vec3* points = (const vec3*)(file.begin() + nodes[i].offset);
+			resident[i].assign(points, points + nodes[i].count);
+			residentBytes += resident[i].size() * sizeof(vec3);
+		}
+		lastUse[i] = ++uses;
+	}
+
+	void unload(uint32_t i) {
+		residentBytes -= resident[i].size() * sizeof(vec3);
+		vector<vec3>().swap(resident[i]);
+	}
+
+	// unload the nodes used least recently until the points take at most limit bytes, the
+	// nodes used after the use last are kept
+	void evict(size_t limit, uint64_t last) {
+		if (residentBytes <= limit) {
+			return;
+		}
+		vector<uint32_t> loadedNodes;
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			if (isLoaded(i) && lastUse[i] <= last) {
+				loadedNodes.push_back(i);
+			}
+		}
+		std::sort(loadedNodes.begin(), loadedNodes.end(), [this](uint32_t a, uint32_t b) { return lastUse[a] < lastUse[b]; });
+		for (size_t k = 0; k < loadedNodes.size() && residentBytes > limit; k++) {
+			unload(loadedNodes[k]);
+		}
+	}
+
+	// how coarse the points of a node look from eye, the spacing over the distance
+	float coarseness(uint32_t i, const vec3& eye) const {
+		float spacing = nodes[i].size / POINT_SAMPLE_GRID;
+		float d = sqrtf(boxDistanceSquared(eye, nodes[i].minPos, nodes[i].minPos + vec3(nodes[i].size)));
+		return spacing / std::max(d, 1e-6f);
+	}
+
+	void collectVisible(uint32_t i, vector<uint32_t>& result) const {
+		if (!isLoaded(i)) {
+			return;
+		}
+		const PointNode& node = nodes[i];
+		// the children must all be loaded and still wanted by the last update
+		bool refined = node.childMask != 0;
+		for (int k = 0; k < 8 && refined; k++) {
+			if (node.childMask & (1u << k)) {
+				uint32_t child = pointChild(node, k);
+				refined = isLoaded(child) && wantedAt[child] == clock;
+			}
+		}
+		if (!refined) {
+			result.push_back(i);
+			return;
+		}
+		for (int k = 0; k < 8; k++) {
+			if (node.childMask & (1u << k)) {
+				collectVisible(pointChild(node, k), result);
+			}
+		}
+	}
+
+public:
+	PointCloud() : nodes(nullptr), nodeCount(0), clock(0), uses(0), residentBytes(0), budget(SIZE_MAX) {}
+
+	PointCloud(const PointCloud&) = delete;
+	PointCloud& operator=(const PointCloud&) = delete;
+
+	// open the paged file of a PLY file, building it first when it is missing or stale
+	bool open(const char* path) {
+		file.close();
+		nodes = nullptr;
+		nodeCount = 0;
+		MeshSource source;
+		if (!describeMeshSource(path, source)) {
+			cout << "ERROR: POINT CLOUD " << path << " UNABLE TO LOAD!" << endl;
+			return false;
+		}
+		string cachePath = string(path) + POINT_CLOUD_SUFFIX;
+		if (!openCache(cachePath.c_str(), source)) {
+			PointCloudBuilder builder;
+			if (!builder.build(path, source, cachePath) || !openCache(cachePath.c_str(), source)) {
+				return false;
+			}
+		}
+		resident.assign(nodeCount, vector<vec3>());
+		lastUse.assign(nodeCount, 0);
+		wantedAt.assign(nodeCount, 0);
+		uses = 0;
+		residentBytes = 0;
+		return true;
+	}
+
+	// load the nodes seen from eye with points no coarser than detail, coarsest first, as far
+	// as the budget in bytes allows, and evict the ones used least recently beyond it
+	void update(const vec3& eye, size_t bytes, float detail = POINT_CLOUD_DETAIL) {
+		if (nodeCount == 0) {
+			return;
+		}
+		clock++;
+		budget = bytes;
+		uint64_t before = uses;
+		priority_queue<pair<float, uint32_t> > queue;
+		queue.push(make_pair(coarseness(0, eye), 0u));
+		size_t wanted = 0, loaded = 0;
+		while (!queue.empty()) {
+			uint32_t i = queue.top().second;
+			float c = queue.top().first;
+			queue.pop();
+			wanted += nodes[i].count * sizeof(vec3);
+			if (wanted > budget) {
+				break;
+			}
+			if (!isLoaded(i)) {
+				if (loaded >= POINT_CLOUD_LOAD_BYTES) {
+					continue;
+				}
+				loaded += nodes[i].count * sizeof(vec3);
+			}
+			load(i);
+			wantedAt[i] = clock;
+			if (c > detail) {
+				for (int k = 0; k < 8; k++) {
+					if (nodes[i].childMask & (1u << k)) {
+						uint32_t child = pointChild(nodes[i], k);
+						queue.push(make_pair(coarseness(child, eye), child));
+					}
+				}
+			}
+		}
+		evict(budget, before);
+	}
+
+	// the point nearest to p within maxDistance, false if there is none, loads the leaves it
+	// needs, making room for each within the budget of the last update
+	bool nearestPoint(const vec3& p, float maxDistance, vec3& result) {
+		if (nodeCount == 0) {
+			return false;
+		}
+		float best = maxDistance * maxDistance;
+		bool found = false;
+		vector<uint32_t> stack(1, 0u);
+		while (!stack.empty()) {
+			uint32_t i = stack.back();
+			stack.pop_back();
+			const PointNode& node = nodes[i];
+			if (boxDistanceSquared(p, node.minPos, node.minPos + vec3(node.size)) > best) {
+				continue;
+			}
+			if (node.childMask == 0) {
+				if (!isLoaded(i)) {
+					size_t bytes = node.count * sizeof(vec3);
+					evict(budget > bytes ? budget - bytes : 0, uses);
+				}
+				load(i);
+				for (auto& q : resident[i]) {
+					vec3 d = q - p;
+					if (dot(d, d) <= best) {
+						best = dot(d, d);
+						result = q;
+						found = true;
+					}
+				}
+				continue;
+			}
+			// the child holding p is popped first
+			ivec3 side(glm::greaterThanEqual(p, node.minPos + vec3(node.size * 0.5f)));
+			int nearest = side.x + 2 * side.y + 4 * side.z;
+			for (int k = 0; k < 8; k++) {
+				if ((node.childMask & (1u << k)) && k != nearest) {
+					stack.push_back(pointChild(node, k));
+				}
+			}
+			if (node.childMask & (1u << nearest)) {
+				stack.push_back(pointChild(node, nearest));
+			}
+		}
+		return found;
+	}
+
+	// the loaded nodes to draw, each node is replaced by its children once all of them are loaded
+	void visibleNodes(vector<uint32_t>& result) const {
+		result.clear();
+		if (nodeCount > 0) {
+			collectVisible(0, result);
+		}
+	}
+
+	size_t numNodes() const {
+		return nodeCount;
+	}
+
+	const PointNode& node(uint32_t i) const {
+		return nodes[i];
+	}
+
+	bool isLoaded(uint32_t i) const {
+		return !resident[i].empty();
+	}
+
+	const vector<vec3>& points(uint32_t i) const {
+		return resident[i];
+	}
+
+	size_t getResidentBytes() const {
+		return residentBytes;
+	}
+
+	// the box around all the points
+	void bounds(vec3& minPos, vec3& maxPos) const {
+		const PointCloudHeader* h = (const PointCloudHeader*)file.begin();
+		minPos = nodeCount > 0 ? h->pointsMin : vec3(0.0f);
+		maxPos = nodeCount > 0 ? h->pointsMax : vec3(0.0f);
+	}
+};
+
+#endif
@@ -0,0 +1,86 @@
+// draws the loaded nodes of a point cloud with resources/shader/point.vs and point.fs
+// every node drawn gets a buffer of its own, uploaded the first time it is drawn and freed
+// once the cloud evicts it, so the gpu holds no more than the loader does
+
+#ifndef POINT_RENDERER_H
+#define POINT_RENDERER_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <unordered_map>
+#include "point_cloud.h"
+
+using namespace std;
+
+class PointCloudRenderer {
+private:
+	struct NodeBuffer {
+		unsigned int vao;
+		unsigned int vbo;
+		size_t count;
+	};
+
+	unordered_map<uint32_t, NodeBuffer> buffers;
+	vector<uint32_t> visible;
+
+	void upload(const vector<vec3>& points, NodeBuffer& buffer) {
+		buffer.count = points.size();
+		glGenVertexArrays(1, &buffer.vao);
+		glGenBuffers(1, &buffer.vbo);
+		glBindVertexArray(buffer.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+		glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(vec3), points.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+		glEnableVertexAttribArray(0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	static void free(NodeBuffer& buffer) {
+		glDeleteVertexArrays(1, &buffer.vao);
+		glDeleteBuffers(1, &buffer.vbo);
+	}
+
+public:
+	PointCloudRenderer() {}
+
+	PointCloudRenderer(const PointCloudRenderer&) = delete;
+	PointCloudRenderer& operator=(const PointCloudRenderer&) = delete;
+
+	~PointCloudRenderer() {
+		release();
+	}
+
+	// the shader must be in use with its model matrix set, needs a current context
+	void draw(const PointCloud& cloud) {
+		for (auto it = buffers.begin(); it != buffers.end();) {
+			if (!cloud.isLoaded(it->first)) {
+				free(it->second);
+				it = buffers.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		cloud.visibleNodes(visible);
+		for (uint32_t i : visible) {
+			auto it = buffers.find(i);
+			if (it == buffers.end()) {
+				it = buffers.insert(make_pair(i, NodeBuffer())).first;
+				upload(cloud.points(i), it->second);
+			}
+			glBindVertexArray(it->second.vao);
+			glDrawArrays(GL_POINTS, 0, (GLsizei)it->second.count);
+		}
+		glBindVertexArray(0);
+	}
+
+	void release() {
+		for (auto& b : buffers) {
+			free(b.second);
+		}
+		buffers.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,110 @@
+// a counter-based random generator (Philox4x32-10)
+// reference: Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011
+// every value is a pure function of (seed, index, stream, draw) so any thread
+// can produce the numbers of any ball, and the result does not depend on the
+// number of threads
+// the integers and the uniform floats made from them are the same on every platform, the
+// gaussians go through logf and cosf, which may round differently in another libm
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include "global.h"
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+// multipliers and Weyl key increments from the paper
+const uint32_t PHILOX_M0 = 0xD2511F53u;
+const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+const uint32_t PHILOX_W0 = 0x9E3779B9u;
+const uint32_t PHILOX_W1 = 0xBB67AE85u;
+const int PHILOX_ROUNDS = 10;
+
+// encrypt a 128 bit counter with a 64 bit key
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int r = 0; r < PHILOX_ROUNDS; r++) {
+		uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+		uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+		uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// streams of one seed, so the values drawn for different purposes never overlap
+enum RandomStream {
+	STREAM_BALL = 0, STREAM_SCENE
+};
+
+// an independent sequence of random numbers for one (seed, index, stream),
+// e.g. all the attributes of one ball
+class CounterRandom {
+private:
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4];
+	int used;
+
+	uint32_t next() {
+		if (used == 4) {
+			philox4x32(counter, key, block);
+			counter[2]++;
+			used = 0;
+		}
+		return block[used++];
+	}
+
+public:
+	CounterRandom(uint64_t seed, uint64_t index, uint32_t stream=STREAM_BALL) : used(4) {
+		key[0] = (uint32_t)seed;
+		key[1] = (uint32_t)(seed >> 32);
+		counter[0] = (uint32_t)index;
+		counter[1] = (uint32_t)(index >> 32);
+		counter[2] = 0;
+		counter[3] = stream;
+	}
+
+	// a float in [0, 1) built from the top 24 bits, exact in single precision
+	float uniform() {
+		return (next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float uniform(float lo, float hi) {
+		return lo + uniform() * (hi - lo);
+	}
+
+	vec3 uniformVec() {
+		float x = uniform();
+		float y = uniform();
+		float z = uniform();
+		return vec3(x, y, z);
+	}
+
+	// an integer in [0, n)
+	uint32_t uniformInt(uint32_t n) {
+		return (uint32_t)(((uint64_t)next() * n) >> 32);
+	}
+
+	// standard normal with the Box-Muller transform
+	float gaussian() {
+		float u1 = 1.0f - uniform();
+		float u2 = uniform();
+		return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * u2);
+	}
+};
+
+#endif
@@ -8,19 +8,21 @@ struct Material {
     float shininess;
 }; 
 
-struct Light {
+in vec3 FragPos;  
+in vec3 Normal;  
+  
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+layout (std140) uniform Light {
 	vec3 direction;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
-};
-
-in vec3 FragPos;  
-in vec3 Normal;  
-  
-uniform vec3 viewPos;
+} light;
 uniform Material material;
-uniform Light light;
 
 void main()
 {
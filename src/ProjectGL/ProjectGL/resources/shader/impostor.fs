@@ -0,0 +1,57 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+flat in vec3 Center;
+flat in float Radius;
+flat in vec3 Color;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+layout (std140) uniform Light {
+	vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+} light;
+uniform float shininess;
+
+void main()
+{
+    // intersect the ray from the camera through this fragment with the sphere
+    vec3 rayDir = normalize(FragPos - viewPos);
+    vec3 oc = viewPos - Center;
+    float b = dot(oc, rayDir);
+    float c = dot(oc, oc) - Radius * Radius;
+    float disc = b * b - c;
+    if (disc < 0.0)
+        discard;
+    vec3 hit = viewPos + rayDir * (-b - sqrt(disc));
+
+    // the depth of the hit point instead of the quad, so balls intersect correctly
+    vec4 clip = projection * view * vec4(hit, 1.0);
+    float ndcDepth = clip.z / clip.w;
+    gl_FragDepth = (gl_DepthRange.diff * ndcDepth + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+    // the same Phong lighting as ball.fs
+    // ambient
+    vec3 ambient = light.ambient * Color;
+
+    // diffuse
+    vec3 norm = (hit - Center) / Radius;
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * (diff * Color);
+
+    // specular
+    vec3 viewDir = -rayDir;
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3 specular = light.specular * (spec * Color * 0.6);
+
+    vec3 result = ambient + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
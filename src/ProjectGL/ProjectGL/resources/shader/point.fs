@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+uniform vec3 color;
+
+void main()
+{
+    // scans carry no normals, so the points are only dimmed with distance to keep some depth
+    float fade = 1.0 / (1.0 + 0.05 * length(viewPos - FragPos));
+    FragColor = vec4(color * (0.4 + 0.6 * fade), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 FragPos;
+
+uniform mat4 model;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,292 @@
+// a class to describe and generate reproducible ball scenes
+// a scene is read from a key=value file and/or --key=value command line options
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "global.h"
+#include "octree.h"
+#include "random.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+enum Distribution {
+	LATTICE, UNIFORM, CLUSTERED, PILE
+};
+
+enum RadiusDistribution {
+	RADIUS_UNIFORM, RADIUS_FIXED, RADIUS_BIMODAL, RADIUS_LOGNORMAL
+};
+
+struct SceneSpec {
+	int numBalls = NUM_BALLS;
+	Distribution distribution = LATTICE;
+	RadiusDistribution radiusDistribution = RADIUS_UNIFORM;
+	float minRadius = MIN_RADIUS;
+	float maxRadius = MAX_RADIUS;
+	float radiusSigma = 0.5f; // lognormal spread
+	int numClusters = 8;
+	float clusterSpread = 1.0f; // standard deviation of a cluster
+	float minSpeed = MIN_SPEED;
+	float maxSpeed = MAX_SPEED;
+	unsigned long long seed = 1;
+	int numThreads = 0; // 0 picks the hardware concurrency
+	OctreeParams octree;
+};
+
+// the balls are handed out to the threads in chunks of fixed size
+const int SCENE_CHUNK_SIZE = 4096;
+
+// parse one option of the scene description, return false if the key or the value is unknown
+bool setSceneOption(SceneSpec& spec, const string& key, const string& value) {
+	stringstream in(value);
+	bool ok = true;
+	if (key == "balls") {
+		ok = (bool)(in >> spec.numBalls);
+		if (ok && spec.numBalls <= 0) {
+			cout << "ERROR: SCENE NEEDS AT LEAST ONE BALL!" << endl;
+			return false;
+		}
+	}
+	else if (key == "distribution") {
+		if (value == "lattice") spec.distribution = LATTICE;
+		else if (value == "uniform") spec.distribution = UNIFORM;
+		else if (value == "clustered") spec.distribution = CLUSTERED;
+		else if (value == "pile") spec.distribution = PILE;
+		else ok = false;
+	}
+	else if (key == "radius") {
+		if (value == "uniform") spec.radiusDistribution = RADIUS_UNIFORM;
+		else if (value == "fixed") spec.radiusDistribution = RADIUS_FIXED;
+		else if (value == "bimodal") spec.radiusDistribution = RADIUS_BIMODAL;
+		else if (value == "lognormal") spec.radiusDistribution = RADIUS_LOGNORMAL;
+		else ok = false;
+	}
+	else if (key == "min_radius") ok = (bool)(in >> spec.minRadius);
+	else if (key == "max_radius") ok = (bool)(in >> spec.maxRadius);
+	else if (key == "radius_sigma") ok = (bool)(in >> spec.radiusSigma);
+	else if (key == "clusters") ok = (bool)(in >> spec.numClusters);
+	else if (key == "cluster_spread") ok = (bool)(in >> spec.clusterSpread);
+	else if (key == "min_speed") ok = (bool)(in >> spec.minSpeed);
+	else if (key == "max_speed") ok = (bool)(in >> spec.maxSpeed);
+	else if (key == "seed") ok = (bool)(in >> spec.seed);
+	else if (key == "threads") ok = (bool)(in >> spec.numThreads);
+	else if (key == "max_depth") ok = (bool)(in >> spec.octree.maxDepth);
+	else if (key == "min_balls_per_octree") ok = (bool)(in >> spec.octree.minBallsPerOctree);
+	else if (key == "max_balls_per_octree") ok = (bool)(in >> spec.octree.maxBallsPerOctree);
+	else ok = false;
+
+	if (!ok) {
+		cout << "ERROR: UNKNOWN SCENE OPTION " << key << "=" << value << endl;
+	}
+	return ok;
+}
+
+// read a scene file made of key=value lines, '#' starts a comment
+bool loadSceneFile(const char* path, SceneSpec& spec) {
+	ifstream file(path);
+	if (!file) {
+		cout << "ERROR: SCENE FILE UNABLE TO LOAD!" << endl;
+		return false;
+	}
+	bool ok = true;
+	string line;
+	while (getline(file, line)) {
+		line = line.substr(0, line.find('#'));
+		size_t eq = line.find('=');
+		if (eq == string::npos) {
+			continue;
+		}
+		stringstream key(line.substr(0, eq)), value(line.substr(eq + 1));
+		string k, v;
+		key >> k;
+		value >> v;
+		ok = setSceneOption(spec, k, v) && ok;
+	}
+	return ok;
+}
+
+// split a --<key>=<value> argument, return false if it is not of that form
+bool splitArg(const string& arg, string& key, string& value) {
+	size_t eq = arg.find('=');
+	if (arg.compare(0, 2, "--") != 0 || eq == string::npos) {
+		return false;
+	}
+	key = arg.substr(2, eq - 2);
+	value = arg.substr(eq + 1);
+	return true;
+}
+
+// apply --scene=<file> or any other scene option
+bool parseSceneArg(const string& key, const string& value, SceneSpec& spec) {
+	if (key == "scene") {
+		return loadSceneFile(value.c_str(), spec);
+	}
+	return setSceneOption(spec, key, value);
+}
+
+// parse --scene=<file> and --<key>=<value> options, later options override earlier ones
+bool parseSceneArgs(int argc, char** argv, SceneSpec& spec) {
+	bool ok = true;
+	for (int i = 1; i < argc; i++) {
+		string key, value;
+		if (splitArg(argv[i], key, value)) {
+			ok = parseSceneArg(key, value, spec) && ok;
+		}
+	}
+	return ok;
+}
+
+class SceneGenerator {
+private:
+	const SceneSpec& spec;
+	vector<vec3> clusterCenters;
+	int latticeDim;
+	float latticeStep;
+	int pileDim;
+	float pileStep;
+
+	float sampleRadius(CounterRandom& rng) {
+		switch (spec.radiusDistribution) {
+		case RADIUS_FIXED:
+			return spec.maxRadius;
+		case RADIUS_BIMODAL:
+			// two thin peaks at the bounds of the radius range
+			return rng.uniform() < 0.5f ?
+				spec.minRadius + rng.uniform() * 0.05f * (spec.maxRadius - spec.minRadius) :
+				spec.maxRadius - rng.uniform() * 0.05f * (spec.maxRadius - spec.minRadius);
+		case RADIUS_LOGNORMAL: {
+			// expf, like the gaussian, is only as reproducible across platforms as the libm
+			float median = sqrtf(spec.minRadius * spec.maxRadius);
+			float r = median * expf(spec.radiusSigma * rng.gaussian());
+			return glm::clamp(r, spec.minRadius, spec.maxRadius);
+		}
+		default:
+			return rng.uniform(spec.minRadius, spec.maxRadius);
+		}
+	}
+
+	vec3 samplePos(int i, float radius, CounterRandom& rng) {
+		vec3 lo = MIN_POS + vec3(radius + EPS);
+		vec3 hi = MAX_POS - vec3(radius + EPS);
+		switch (spec.distribution) {
+		case UNIFORM:
+			return lo + rng.uniformVec() * (hi - lo);
+		case CLUSTERED: {
+			int c = rng.uniformInt((uint32_t)clusterCenters.size());
+			float x = rng.gaussian();
+			float y = rng.gaussian();
+			float z = rng.gaussian();
+			return glm::clamp(clusterCenters[c] + vec3(x, y, z) * spec.clusterSpread, lo, hi);
+		}
+		case PILE: {
+			// fill the box layer by layer from the floor with a jittered grid
+			int layer = i / (pileDim * pileDim);
+			int row = i / pileDim % pileDim;
+			int col = i % pileDim;
+			vec3 cell = MIN_POS + vec3(col + 0.5f, layer + 0.5f, row + 0.5f) * pileStep;
+			vec3 jitter = (rng.uniformVec() - 0.5f) * (pileStep - 2 * radius - EPS);
+			jitter.y = 0.0f;
+			return glm::clamp(cell + jitter, lo, hi);
+		}
+		default: {
+			int index1 = i / (latticeDim * latticeDim);
+			int index2 = i / latticeDim % latticeDim;
+			int index3 = i % latticeDim;
+			vec3 corner = vec3(-0.5f * latticeStep * (latticeDim - 1));
+			return corner + vec3(index1, index2, index3) * latticeStep;
+		}
+		}
+	}
+
+	void generateChunk(int chunk, vector<Ball*>& balls) {
+		int first = chunk * SCENE_CHUNK_SIZE;
+		int last = std::min(first + SCENE_CHUNK_SIZE, (int)balls.size());
+		for (int i = first; i < last; i++) {
+			// every ball draws from its own stream keyed by its index
+			CounterRandom rng(spec.seed, i);
+			Ball* b = new Ball();
+			b->radius = sampleRadius(rng);
+			if (spec.distribution == PILE) {
+				// stratified by size, the largest balls at the bottom
+				int layer = i / (pileDim * pileDim);
+				int numLayers = ((int)balls.size() + pileDim * pileDim - 1) / (pileDim * pileDim);
+				float t = numLayers > 1 ? (float)layer / (numLayers - 1) : 0.0f;
+				float r = spec.maxRadius - t * (spec.maxRadius - spec.minRadius);
+				b->radius = glm::clamp(r + (b->radius - 0.5f * (spec.minRadius + spec.maxRadius)) * 0.1f,
+					spec.minRadius, spec.maxRadius);
+			}
+			b->pos = samplePos(i, b->radius, rng);
+			b->velocity = rng.uniformVec() * (spec.maxSpeed - spec.minSpeed) + spec.minSpeed;
+			if (spec.distribution == PILE) {
+				b->velocity = vec3(0.0f);
+			}
+			b->mass = rng.uniform(MIN_MASS, MAX_MASS);
+			b->cor = rng.uniform(MIN_COR, MAX_COR);
+			b->color = rng.uniformVec() * 0.6f + 0.2f;
+			b->index = i;
+			balls[i] = b;
+		}
+	}
+
+public:
+	SceneGenerator(const SceneSpec& spec) : spec(spec) {
+		latticeDim = std::max(1, (int)ceilf(cbrtf((float)spec.numBalls) - EPS));
+		latticeStep = std::min(2 * spec.maxRadius + EPS, (SIZE - 2 * spec.maxRadius) / latticeDim);
+		pileStep = 2 * spec.maxRadius + EPS;
+		pileDim = std::max(1, (int)(SIZE / pileStep));
+
+		CounterRandom rng(spec.seed, 0, STREAM_SCENE);
+		for (int i = 0; i < spec.numClusters; i++) {
+			vec3 lo = MIN_POS + vec3(spec.clusterSpread);
+			vec3 hi = MAX_POS - vec3(spec.clusterSpread);
+			clusterCenters.push_back(lo + rng.uniformVec() * (hi - lo));
+		}
+		if (clusterCenters.empty()) {
+			clusterCenters.push_back(vec3(0.0f));
+		}
+	}
+
+	// the number of balls that fit, only the pile is bounded by the box
+	int capacity() const {
+		if (spec.distribution == PILE) {
+			return pileDim * pileDim * pileDim;
+		}
+		return spec.numBalls;
+	}
+
+	void generate(vector<Ball*>& balls) {
+		int numBalls = std::min(spec.numBalls, capacity());
+		if (numBalls < spec.numBalls) {
+			cout << "WARNING: ONLY " << numBalls << " BALLS FIT IN THE PILE" << endl;
+		}
+		balls.assign(numBalls, nullptr);
+
+		int numChunks = (numBalls + SCENE_CHUNK_SIZE - 1) / SCENE_CHUNK_SIZE;
+		int numThreads = spec.numThreads > 0 ? spec.numThreads : (int)thread::hardware_concurrency();
+		numThreads = std::max(1, std::min(numThreads, numChunks));
+
+		vector<thread> workers;
+		for (int t = 0; t < numThreads; t++) {
+			workers.push_back(thread([this, t, numThreads, numChunks, &balls]() {
+				for (int c = t; c < numChunks; c += numThreads) {
+					generateChunk(c, balls);
+				}
+			}));
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,151 @@
+// a signed distance field of a mesh sampled on a regular grid, negative inside
+// only a narrow band around the surface is measured, through the nearest point
+// queries on the bvh, the other cells hold plus or minus the band width
+// the sign of every cell comes from the winding number of the mesh at it, which unlike a
+// normal at the nearest point is right at sharp edges and corners, and for models with
+// holes or faces passing through each other, where no flood from the band could be trusted
+// a lookup is a trilinear interpolation of eight cells and gives the gradient, the
+// direction out of the surface, with it
+
+#ifndef SDF_H
+#define SDF_H
+
+#include "mesh_cache.h"
+#include "mesh_query.h"
+#include <vector>
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// cells whose exact winding number is closer to one half than this are not checked, the
+// surface is open around them and either sign is as good
+const float SDF_CHECK_AMBIGUITY = 0.25f;
+
+class SignedDistanceField {
+private:
+	vec3 origin; // the center of cell (0, 0, 0)
+	float cellSize;
+	ivec3 dims;
+	float band;
+	vector<float> distance; // x fastest
+
+	size_t cell(int x, int y, int z) const {
+		return ((size_t)z * dims.y + y) * dims.x + x;
+	}
+
+	// the signed distance of one point, clamped to the band
+	float measure(const MeshView& mesh, const vector<BvhDipole>& dipoles, const vec3& p) const {
+		MeshHit hit;
+		float d = nearestPointOnMesh(mesh, p, band, hit) ? hit.distance : band;
+		return windingNumber(mesh, dipoles, p) > 0.5f ? -d : d;
+	}
+
+public:
+	SignedDistanceField() : origin(0.0f), cellSize(1.0f), dims(0), band(0.0f) {}
+
+	// sample the mesh with the given number of cells along its longest side, measuring
+	// distances up to bandCells cells from the surface, the slices are spread over threads
+	void bake(const MeshView& mesh, int resolution, float bandCells = 3.0f) {
+		distance.clear();
+		dims = ivec3(0);
+		if (mesh.numNodes() == 0 || resolution <= 0) {
+			return;
+		}
+		vec3 lo = mesh.nodes()[0].minPos, hi = mesh.nodes()[0].maxPos;
+		vec3 extent = hi - lo;
+		cellSize = std::max(extent.x, std::max(extent.y, extent.z)) / resolution;
+		band = bandCells * cellSize;
+		// one band of cells around the bounds so the outside of the surface is sampled too
+		int margin = (int)ceilf(bandCells) + 1;
+		dims = ivec3(glm::ceil(extent / cellSize)) + 1 + 2 * margin;
+		origin = lo - vec3(margin * cellSize);
+		distance.assign((size_t)dims.x * dims.y * dims.z, band);
+		vector<BvhDipole> dipoles;
+		computeDipoles(mesh, dipoles);
+
+		int numThreads = std::max(1, std::min((int)thread::hardware_concurrency(), dims.z));
+		vector<thread> workers;
+		for (int t = 0; t < numThreads; t++) {
+			workers.push_back(thread([this, t, numThreads, &mesh, &dipoles]() {
+				for (int z = t; z < dims.z; z += numThreads) {
+					for (int y = 0; y < dims.y; y++) {
+						for (int x = 0; x < dims.x; x++) {
+							distance[cell(x, y, z)] = measure(mesh, dipoles, origin + vec3(x, y, z) * cellSize);
+						}
+					}
+				}
+			}));
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+	}
+
+	bool isBaked() const {
+		return !distance.empty();
+	}
+
+	// compare the signs of random cells with the exact winding number, return how many
+	// disagree, checked is the number of cells that were not ambiguous
+	int countSignErrors(const MeshView& mesh, int samples, int& checked) const {
+		checked = 0;
+		if (distance.empty()) {
+			return 0;
+		}
+		mt19937 random(1);
+		int wrong = 0;
+		for (int s = 0; s < samples; s++) {
+			size_t i = random() % distance.size();
+			vec3 p = origin + vec3(ivec3(i % dims.x, i / dims.x % dims.y, i / ((size_t)dims.x * dims.y))) * cellSize;
+			float winding = exactWindingNumber(mesh, p);
+			if (fabsf(winding - 0.5f) < SDF_CHECK_AMBIGUITY) {
+				continue;
+			}
+			checked++;
+			if ((winding > 0.5f) != (distance[i] < 0.0f)) {
+				wrong++;
+			}
+		}
+		return wrong;
+	}
+
+	// the distance beyond which the field is clamped
+	float getBand() const {
+		return band;
+	}
+
+	// the signed distance at p and its gradient, the band width outside the grid
+	float sample(const vec3& p, vec3& gradient) const {
+		vec3 g = (p - origin) / cellSize;
+		if (!(g.x >= 0.0f && g.y >= 0.0f && g.z >= 0.0f && g.x < dims.x - 1 && g.y < dims.y - 1 && g.z < dims.z - 1)) {
+			gradient = vec3(0.0f);
+			return band;
+		}
+		ivec3 i = ivec3(g);
+		vec3 f = g - vec3(i);
+		size_t base = cell(i.x, i.y, i.z);
+		size_t dy = dims.x, dz = (size_t)dims.x * dims.y;
+		float c000 = distance[base], c100 = distance[base + 1];
+		float c010 = distance[base + dy], c110 = distance[base + dy + 1];
+		float c001 = distance[base + dz], c101 = distance[base + dz + 1];
+		float c011 = distance[base + dy + dz], c111 = distance[base + dy + dz + 1];
+		// interpolate along x, then y, then z, keeping the derivatives of each step
+		float c00 = c000 + (c100 - c000) * f.x, c10 = c010 + (c110 - c010) * f.x;
+		float c01 = c001 + (c101 - c001) * f.x, c11 = c011 + (c111 - c011) * f.x;
+		float c0 = c00 + (c10 - c00) * f.y, c1 = c01 + (c11 - c01) * f.y;
+		float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * f.y;
+		float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * f.y;
+		gradient.x = (dx0 + (dx1 - dx0) * f.z) / cellSize;
+		gradient.y = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * f.z) / cellSize;
+		gradient.z = (c1 - c0) / cellSize;
+		return c0 + (c1 - c0) * f.z;
+	}
+};
+
+#endif
@@ -11,11 +11,75 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
 
 using namespace std;
 
+// 32 bit FNV-1a, constexpr so uniform names written as literals are hashed at compile time
+const uint32_t FNV_OFFSET = 2166136261u;
+const uint32_t FNV_PRIME = 16777619u;
+
+constexpr uint32_t hashName(const char* name, uint32_t hash = FNV_OFFSET)
+{
+	return *name == 0 ? hash : hashName(name + 1, (hash ^ (uint8_t)*name) * FNV_PRIME);
+}
+
+// a uniform is looked up by the hash of its name
+struct UniformName
+{
+	uint32_t hash;
+
+	constexpr UniformName(const char* name) : hash(hashName(name)) {}
+	UniformName(const std::string& name) : hash(hashName(name.c_str())) {}
+};
+
+// binding points of the uniform blocks shared by all the programs
+enum UniformBlockBinding {
+	CAMERA_BLOCK = 0, LIGHT_BLOCK
+};
+
 class Shader 
 {
+private:
+	// hash and location of every active uniform, sorted by hash, filled at link time
+	vector<pair<uint32_t, GLint> > locations;
+
+	// resolve every active uniform once, so setting one is a binary search instead of
+	// a string lookup in the driver
+	void cacheUniforms()
+	{
+		locations.clear();
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		vector<GLchar> name(std::max(maxLength, 1));
+		for (GLint i = 0; i < count; i++) {
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(ID, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+			GLint location = glGetUniformLocation(ID, name.data());
+			if (location < 0) {
+				// a member of a uniform block
+				continue;
+			}
+			// arrays are reported as name[0], they are set by their plain name
+			string key(name.data());
+			if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+				key.erase(key.size() - 3);
+			}
+			locations.push_back(make_pair(hashName(key.c_str()), location));
+		}
+		sort(locations.begin(), locations.end());
+		for (size_t i = 1; i < locations.size(); i++) {
+			if (locations[i].first == locations[i - 1].first) {
+				std::cout << "ERROR::SHADER_UNIFORM_HASH_COLLISION" << std::endl;
+			}
+		}
+	}
+
 public:
 	unsigned int ID;
 
@@ -65,6 +129,7 @@ public:
 		glAttachShader(ID, fragment);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		cacheUniforms();
 
 		// ɾɫ
 		glDeleteShader(fragment);
@@ -76,64 +141,80 @@ public:
 		glUseProgram(ID);
 	}
 
+	// the cached location of a uniform, -1 if the program has no such uniform
+	GLint location(const UniformName& name) const
+	{
+		auto it = lower_bound(locations.begin(), locations.end(), make_pair(name.hash, (GLint)INT32_MIN));
+		return it != locations.end() && it->first == name.hash ? it->second : -1;
+	}
+
+	// connect a uniform block of the program to a binding point of UniformBlockBinding
+	void bindBlock(const char* blockName, GLuint binding) const
+	{
+		GLuint index = glGetUniformBlockIndex(ID, blockName);
+		if (index != GL_INVALID_INDEX) {
+			glUniformBlockBinding(ID, index, binding);
+		}
+	}
+
 	// һЩsetter
-	void setBool(const std::string &name, bool value) const
+	void setBool(const UniformName &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(location(name), (int)value);
 	}
 
-	void setInt(const std::string &name, int value) const
+	void setInt(const UniformName &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(location(name), value);
 	}
 
-	void setFloat(const std::string &name, float value) const
+	void setFloat(const UniformName &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(location(name), value);
 	}
 
-	void setVec2(const std::string &name, const glm::vec2 &value) const
+	void setVec2(const UniformName &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(location(name), 1, &value[0]);
 	}
 
-	void setVec2(const std::string &name, float x, float y) const
+	void setVec2(const UniformName &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(location(name), x, y);
 	}
 
-	void setVec3(const std::string &name, const glm::vec3 &value) const
+	void setVec3(const UniformName &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(location(name), 1, &value[0]);
 	}
 
-	void setVec3(const std::string &name, float x, float y, float z) const
+	void setVec3(const UniformName &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(location(name), x, y, z);
 	}
 
-	void setVec4(const std::string &name, const glm::vec4 &value) const
+	void setVec4(const UniformName &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(location(name), 1, &value[0]);
 	}
-	void setVec4(const std::string &name, float x, float y, float z, float w)
+	void setVec4(const UniformName &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(location(name), x, y, z, w);
 	}
 
-	void setMat2(const std::string &name, const glm::mat2 &mat) const
+	void setMat2(const UniformName &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
-	void setMat3(const std::string &name, const glm::mat3 &mat) const
+	void setMat3(const UniformName &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
-	void setMat4(const std::string &name, const glm::mat4 &mat) const
+	void setMat4(const UniformName &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
 private:
@@ -0,0 +1,324 @@
+// the primitive shapes besides the balls: spheres, capsules and oriented boxes
+// every pair of shapes has its own contact test, overloaded on the two shape types so the
+// caller picks it at compile time, with the shape of the lower ShapeType first
+// a test returns whether the shapes overlap, and then the normal that pushes the first out
+// of the second and how deep the first is inside
+// reference: Christer Ericson, "Real-Time Collision Detection", 2004
+
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include "global.h"
+#include "mesh.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+enum ShapeType {
+	SHAPE_SPHERE = 0, SHAPE_CAPSULE, SHAPE_BOX, SHAPE_TYPES
+};
+
+struct SphereShape {
+	vec3 center;
+	float radius;
+
+	SphereShape() : center(0.0f), radius(0.0f) {}
+	SphereShape(const vec3& center, float radius) : center(center), radius(radius) {}
+};
+
+// the points within radius of the segment from a to b
+struct CapsuleShape {
+	vec3 a;
+	vec3 b;
+	float radius;
+
+	CapsuleShape() : a(0.0f), b(0.0f), radius(0.0f) {}
+	CapsuleShape(const vec3& a, const vec3& b, float radius) : a(a), b(b), radius(radius) {}
+};
+
+// the columns of axes are the unit axes of the box, half its extent along each
+struct BoxShape {
+	vec3 center;
+	mat3 axes;
+	vec3 half;
+
+	BoxShape() : center(0.0f), axes(1.0f), half(0.0f) {}
+	BoxShape(const vec3& center, const mat3& axes, const vec3& half) : center(center), axes(axes), half(half) {}
+};
+
+const int SHAPE_BOX_DEPTH_STEPS = 32; // of the search for the deepest point of a capsule in a box
+const int SHAPE_MESH_STACKS = 16; // of a capsule mesh, even so the cylinder starts at a ring
+const int SHAPE_MESH_SECTORS = 24;
+
+inline void shapeBounds(const SphereShape& s, vec3& minPos, vec3& maxPos) {
+	minPos = s.center - vec3(s.radius);
+	maxPos = s.center + vec3(s.radius);
+}
+
+inline void shapeBounds(const CapsuleShape& s, vec3& minPos, vec3& maxPos) {
+	minPos = glm::min(s.a, s.b) - vec3(s.radius);
+	maxPos = glm::max(s.a, s.b) + vec3(s.radius);
+}
+
+inline void shapeBounds(const BoxShape& s, vec3& minPos, vec3& maxPos) {
+	vec3 extent = abs(s.axes[0]) * s.half.x + abs(s.axes[1]) * s.half.y + abs(s.axes[2]) * s.half.z;
+	minPos = s.center - extent;
+	maxPos = s.center + extent;
+}
+
+// the parameter of the point of segment a b nearest to p
+inline float closestOnSegment(const vec3& p, const vec3& a, const vec3& b) {
+	vec3 ab = b - a;
+	float len2 = dot(ab, ab);
+	return len2 > 0.0f ? glm::clamp(dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+}
+
+// the parameters s on p0 p1 and t on q0 q1 of the nearest points of two segments
+inline void closestOnSegments(const vec3& p0, const vec3& p1, const vec3& q0, const vec3& q1, float& s, float& t) {
+	vec3 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+	float a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	if (a <= 0.0f && e <= 0.0f) {
+		s = t = 0.0f;
+		return;
+	}
+	if (a <= 0.0f) {
+		s = 0.0f;
+		t = glm::clamp(f / e, 0.0f, 1.0f);
+		return;
+	}
+	float c = dot(d1, r);
+	if (e <= 0.0f) {
+		t = 0.0f;
+		s = glm::clamp(-c / a, 0.0f, 1.0f);
+		return;
+	}
+	float b = dot(d1, d2);
+	float denom = a * e - b * b;
+	// parallel segments take any s, 0 is as good as another
+	s = denom > 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+	t = (b * s + f) / e;
+	if (t < 0.0f) {
+		t = 0.0f;
+		s = glm::clamp(-c / a, 0.0f, 1.0f);
+	}
+	else if (t > 1.0f) {
+		t = 1.0f;
+		s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+	}
+}
+
+// signed distance of a point in the space of a box from its surface, negative inside
+inline float boxDistance(const vec3& p, const vec3& half) {
+	vec3 q = abs(p) - half;
+	return length(glm::max(q, vec3(0.0f))) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+}
+
+// two spheres of radius ra and rb around a and b
+inline bool spheresContact(const vec3& a, float ra, const vec3& b, float rb, vec3& normal, float& depth) {
+	vec3 d = a - b;
+	float r = ra + rb;
+	float dist2 = dot(d, d);
+	if (dist2 >= r * r) {
+		return false;
+	}
+	float dist = sqrtf(dist2);
+	// concentric spheres are pushed apart upwards
+	normal = dist > 0.0f ? d / dist : vec3(0.0f, 1.0f, 0.0f);
+	depth = r - dist;
+	return true;
+}
+
+inline bool collideShapes(const SphereShape& a, const SphereShape& b, vec3& normal, float& depth) {
+	return spheresContact(a.center, a.radius, b.center, b.radius, normal, depth);
+}
+
+inline bool collideShapes(const SphereShape& a, const CapsuleShape& b, vec3& normal, float& depth) {
+	vec3 q = mix(b.a, b.b, closestOnSegment(a.center, b.a, b.b));
+	return spheresContact(a.center, a.radius, q, b.radius, normal, depth);
+}
+
+inline bool collideShapes(const SphereShape& a, const BoxShape& b, vec3& normal, float& depth) {
+	vec3 p = transpose(b.axes) * (a.center - b.center);
+	vec3 d = p - glm::clamp(p, -b.half, b.half);
+	float dist2 = dot(d, d);
+	if (dist2 > 0.0f) {
+		if (dist2 >= a.radius * a.radius) {
+			return false;
+		}
+		float dist = sqrtf(dist2);
+		normal = b.axes * (d / dist);
+		depth = a.radius - dist;
+		return true;
+	}
+	// the center is inside, out through the nearest face
+	vec3 gap = b.half - abs(p);
+	int axis = gap.x < gap.y ? (gap.x < gap.z ? 0 : 2) : (gap.y < gap.z ? 1 : 2);
+	normal = b.axes[axis] * (p[axis] >= 0.0f ? 1.0f : -1.0f);
+	depth = a.radius + gap[axis];
+	return true;
+}
+
+inline bool collideShapes(const CapsuleShape& a, const CapsuleShape& b, vec3& normal, float& depth) {
+	float s, t;
+	closestOnSegments(a.a, a.b, b.a, b.b, s, t);
+	return spheresContact(mix(a.a, a.b, s), a.radius, mix(b.a, b.b, t), b.radius, normal, depth);
+}
+
+// the distance to a box is convex along the segment, so its deepest point is found by
+// narrowing the interval around the minimum, and the capsule overlaps the box if a sphere
+// there does
+// the contact is then along the axis of least overlap among the faces of the box, the
+// crosses of the segment with its edges and the normal at the deepest point
+inline bool collideShapes(const CapsuleShape& a, const BoxShape& b, vec3& normal, float& depth) {
+	mat3 toBox = transpose(b.axes);
+	vec3 p0 = toBox * (a.a - b.center), p1 = toBox * (a.b - b.center);
+	float lo = 0.0f, hi = 1.0f;
+	for (int i = 0; i < SHAPE_BOX_DEPTH_STEPS; i++) {
+		float m1 = lo + (hi - lo) / 3.0f, m2 = hi - (hi - lo) / 3.0f;
+		if (boxDistance(mix(p0, p1, m1), b.half) <= boxDistance(mix(p0, p1, m2), b.half)) {
+			hi = m2;
+		}
+		else {
+			lo = m1;
+		}
+	}
+	if (!collideShapes(SphereShape(mix(a.a, a.b, (lo + hi) * 0.5f), a.radius), b, normal, depth)) {
+		return false;
+	}
+	vec3 axes[7];
+	int numAxes = 0;
+	vec3 segment = a.b - a.a;
+	for (int i = 0; i < 3; i++) {
+		axes[numAxes++] = b.axes[i];
+		vec3 n = cross(segment, b.axes[i]);
+		float len = length(n);
+		if (len > 1e-5f) {
+			axes[numAxes++] = n / len;
+		}
+	}
+	axes[numAxes++] = normal;
+	vec3 d = (a.a + a.b) * 0.5f - b.center;
+	depth = INFINITY;
+	for (int k = 0; k < numAxes; k++) {
+		const vec3& n = axes[k];
+		float ra = fabsf(dot(segment, n)) * 0.5f + a.radius;
+		float rb = b.half.x * fabsf(dot(b.axes[0], n)) + b.half.y * fabsf(dot(b.axes[1], n)) + b.half.z * fabsf(dot(b.axes[2], n));
+		float along = dot(d, n);
+		float overlap = ra + rb - fabsf(along);
+		if (overlap < depth) {
+			depth = std::max(overlap, 0.0f);
+			normal = along >= 0.0f ? n : -n;
+		}
+	}
+	return true;
+}
+
+// separating axis test over the face normals of both boxes and the crosses of their edges,
+// the contact is along the axis of least overlap
+inline bool collideShapes(const BoxShape& a, const BoxShape& b, vec3& normal, float& depth) {
+	vec3 axes[15];
+	int numAxes = 0;
+	for (int i = 0; i < 3; i++) {
+		axes[numAxes++] = a.axes[i];
+		axes[numAxes++] = b.axes[i];
+	}
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			vec3 n = cross(a.axes[i], b.axes[j]);
+			float len = length(n);
+			// parallel edges add nothing the face normals do not
+			if (len > 1e-5f) {
+				axes[numAxes++] = n / len;
+			}
+		}
+	}
+	vec3 d = a.center - b.center;
+	depth = INFINITY;
+	for (int k = 0; k < numAxes; k++) {
+		const vec3& n = axes[k];
+		float ra = a.half.x * fabsf(dot(a.axes[0], n)) + a.half.y * fabsf(dot(a.axes[1], n)) + a.half.z * fabsf(dot(a.axes[2], n));
+		float rb = b.half.x * fabsf(dot(b.axes[0], n)) + b.half.y * fabsf(dot(b.axes[1], n)) + b.half.z * fabsf(dot(b.axes[2], n));
+		float along = dot(d, n);
+		float overlap = ra + rb - fabsf(along);
+		if (overlap <= 0.0f) {
+			return false;
+		}
+		if (overlap < depth) {
+			depth = overlap;
+			normal = along >= 0.0f ? n : -n;
+		}
+	}
+	return true;
+}
+
+// the surface of a capsule as a triangle mesh for drawing, two hemispheres joined by a cylinder
+inline void shapeMesh(const CapsuleShape& s, Mesh& mesh) {
+	mesh.clear();
+	vec3 axis = s.b - s.a;
+	float len = length(axis);
+	vec3 w = len > 0.0f ? axis / len : vec3(0.0f, 1.0f, 0.0f);
+	vec3 u = normalize(cross(w, fabsf(w.x) < 0.9f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f)));
+	vec3 v = cross(w, u);
+	// the ring at the equator is repeated, once for each end
+	int rings = SHAPE_MESH_STACKS + 2;
+	for (int r = 0; r < rings; r++) {
+		bool top = r <= SHAPE_MESH_STACKS / 2;
+		float stackAngle = PI / 2 - (top ? r : r - 1) * PI / SHAPE_MESH_STACKS;
+		vec3 end = top ? s.b : s.a;
+		for (int j = 0; j < SHAPE_MESH_SECTORS; j++) {
+			float sectorAngle = j * 2 * PI / SHAPE_MESH_SECTORS;
+			vec3 p = end + s.radius * (cosf(stackAngle) * (cosf(sectorAngle) * u + sinf(sectorAngle) * v) + sinf(stackAngle) * w);
+			mesh.x.push_back(p.x);
+			mesh.y.push_back(p.y);
+			mesh.z.push_back(p.z);
+		}
+	}
+	for (int r = 0; r + 1 < rings; r++) {
+		for (int j = 0; j < SHAPE_MESH_SECTORS; j++) {
+			uint32_t k1 = r * SHAPE_MESH_SECTORS + j, k2 = k1 + SHAPE_MESH_SECTORS;
+			uint32_t n1 = r * SHAPE_MESH_SECTORS + (j + 1) % SHAPE_MESH_SECTORS, n2 = n1 + SHAPE_MESH_SECTORS;
+			uint32_t tris[6] = { k1, k2, n1, n1, k2, n2 };
+			mesh.indices.insert(mesh.indices.end(), tris, tris + 6);
+		}
+	}
+	mesh.computeNormals();
+}
+
+// a sphere is drawn as a capsule with both ends at its center
+inline void shapeMesh(const SphereShape& s, Mesh& mesh) {
+	shapeMesh(CapsuleShape(s.center, s.center, s.radius), mesh);
+}
+
+// the surface of a box as a triangle mesh for drawing, every face with vertices of its own
+// so the normals stay flat
+inline void shapeMesh(const BoxShape& s, Mesh& mesh) {
+	mesh.clear();
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = -1; side <= 1; side += 2) {
+			vec3 n = s.axes[axis] * (float)side;
+			vec3 e1 = s.axes[(axis + 1) % 3] * s.half[(axis + 1) % 3];
+			vec3 e2 = s.axes[(axis + 2) % 3] * s.half[(axis + 2) % 3];
+			// counter-clockwise seen from outside
+			if (side < 0) {
+				std::swap(e1, e2);
+			}
+			vec3 c = s.center + n * s.half[axis];
+			vec3 corners[4] = { c - e1 - e2, c + e1 - e2, c + e1 + e2, c - e1 + e2 };
+			uint32_t base = (uint32_t)mesh.numVertices();
+			for (auto& p : corners) {
+				mesh.x.push_back(p.x);
+				mesh.y.push_back(p.y);
+				mesh.z.push_back(p.z);
+			}
+			uint32_t tris[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+			mesh.indices.insert(mesh.indices.end(), tris, tris + 6);
+		}
+	}
+	mesh.computeNormals();
+}
+
+#endif
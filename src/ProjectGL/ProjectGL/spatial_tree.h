@@ -0,0 +1,399 @@
+// a cubical octree over elements of any type, each bounded by a sphere or a box
+// a bounds policy maps an element to its bound, and the type of the bound picks at compile
+// time how the element is sorted into the children: it goes into every octant its bound
+// reaches, so it may be stored in several leaves
+// a leaf keeps its elements sorted in a vector, which is walked in the same order as a set
+// without a node allocated per entry, and the repeats of straddling elements are dropped
+// with one sort when children are merged back into it
+// a policy looks like
+//   struct BallBounds {
+//       typedef SphereBound Bound;
+//       static SphereBound bound(Ball* b) { return SphereBound(b->pos, b->radius); }
+//   };
+// reference: https://github.com/YDCarry/OctreeCollisionDetection/blob/master/CodeForOctreeCollisionDetection/octree.cpp
+
+#ifndef SPATIAL_TREE_H
+#define SPATIAL_TREE_H
+
+#include "global.h"
+#include "frustum.h"
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// tunables of the octree, the defaults come from global.h
+struct OctreeParams {
+	int maxDepth = MAX_DEPTH;
+	int minBallsPerOctree = MIN_BALLS_PER_OCTREE; // below this an inner node becomes a leaf again
+	int maxBallsPerOctree = MAX_BALLS_PER_OCTREE; // above this a leaf is split
+};
+
+// state shared by every node of one tree, owned by the root
+struct OctreeContext {
+	OctreeParams params;
+	long long splits = 0; // leaves turned into inner nodes
+	long long merges = 0; // inner nodes collapsed back into leaves
+};
+
+// a snapshot of the shape of the tree
+struct OctreeStats {
+	int numNodes = 0;
+	int numLeaves = 0;
+	int numBallRefs = 0; // an element straddling several leaves is counted once per leaf
+	size_t nodeMemory = 0; // bytes
+	vector<int> depthHistogram; // number of leaves per depth
+	vector<int> occupancyHistogram; // number of leaves per element count
+};
+
+struct SphereBound {
+	vec3 center;
+	float radius;
+
+	SphereBound(const vec3& center, float radius) : center(center), radius(radius) {}
+};
+
+struct BoxBound {
+	vec3 minPos;
+	vec3 maxPos;
+
+	BoxBound(const vec3& minPos, const vec3& maxPos) : minPos(minPos), maxPos(maxPos) {}
+};
+
+// the octants a bound reaches, bit i * 4 + j * 2 + k for octant [i][j][k], where
+// bit 0 of each axis is the lower half and bit 1 the upper one
+inline int octantMask(int x, int y, int z) {
+	int mask = 0;
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			for (int k = 0; k < 2; k++) {
+				if ((x >> i & 1) && (y >> j & 1) && (z >> k & 1)) {
+					mask |= 1 << (i * 4 + j * 2 + k);
+				}
+			}
+		}
+	}
+	return mask;
+}
+
+inline int octantMask(const SphereBound& b, const vec3& center) {
+	const vec3& p = b.center;
+	float r = b.radius;
+	return octantMask((p.x > center.x + r ? 0 : 1) | (p.x < center.x - r ? 0 : 2),
+		(p.y > center.y + r ? 0 : 1) | (p.y < center.y - r ? 0 : 2),
+		(p.z > center.z + r ? 0 : 1) | (p.z < center.z - r ? 0 : 2));
+}
+
+inline int octantMask(const BoxBound& b, const vec3& center) {
+	return octantMask((b.minPos.x > center.x ? 0 : 1) | (b.maxPos.x < center.x ? 0 : 2),
+		(b.minPos.y > center.y ? 0 : 1) | (b.maxPos.y < center.y ? 0 : 2),
+		(b.minPos.z > center.z ? 0 : 1) | (b.maxPos.z < center.z ? 0 : 2));
+}
+
+inline bool boundOverlapsBox(const SphereBound& b, const vec3& minPos, const vec3& maxPos) {
+	vec3 d = glm::max(glm::max(minPos - b.center, b.center - maxPos), vec3(0.0f));
+	return dot(d, d) <= b.radius * b.radius;
+}
+
+inline bool boundOverlapsBox(const BoxBound& b, const vec3& minPos, const vec3& maxPos) {
+	return !glm::any(glm::greaterThan(b.minPos, maxPos)) && !glm::any(glm::greaterThan(minPos, b.maxPos));
+}
+
+inline bool boundInFrustum(const Frustum& f, const SphereBound& b, float margin) {
+	return sphereInFrustum(f, b.center, b.radius + margin);
+}
+
+inline bool boundInFrustum(const Frustum& f, const BoxBound& b, float margin) {
+	return classifyBox(f, b.minPos, b.maxPos, margin) != FRUSTUM_OUTSIDE;
+}
+
+template <typename T, typename Bounds>
+class SpatialTree {
+public:
+	typedef typename Bounds::Bound Bound;
+
+private:
+	vec3 minPos; // bottom left back corner
+	vec3 maxPos; // top right front corner
+	vec3 center; // center of the cubical room
+	int numElements; // insertions that reached this node and were not removed
+	int depth;
+	bool leaf;
+	SpatialTree* children[8]; // octant [i][j][k] at i * 4 + j * 2 + k
+	vector<T> elements; // of a leaf, sorted
+	OctreeContext* context;
+	bool ownsContext;
+
+	void addElement(const T& e) {
+		auto it = std::lower_bound(elements.begin(), elements.end(), e);
+		if (it == elements.end() || *it != e) {
+			elements.insert(it, e);
+		}
+	}
+
+	void eraseElement(const T& e) {
+		auto it = std::lower_bound(elements.begin(), elements.end(), e);
+		if (it != elements.end() && *it == e) {
+			elements.erase(it);
+		}
+	}
+
+	// append the elements of every leaf below, repeats included
+	void collectElements(vector<T>& result) const {
+		if (leaf) {
+			result.insert(result.end(), elements.begin(), elements.end());
+			return;
+		}
+		for (int c = 0; c < 8; c++) {
+			children[c]->collectElements(result);
+		}
+	}
+
+	// free the subtree without gathering its elements
+	void destroyChildren() {
+		for (int c = 0; c < 8; c++) {
+			delete children[c];
+			children[c] = nullptr;
+		}
+		leaf = true;
+	}
+
+	void deleteChildren() {
+		collectElements(elements);
+		std::sort(elements.begin(), elements.end());
+		elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+		destroyChildren();
+		context->merges++;
+	}
+
+	void createChildren() {
+		for (int c = 0; c < 8; c++) {
+			vec3 lo(c & 4 ? center.x : minPos.x, c & 2 ? center.y : minPos.y, c & 1 ? center.z : minPos.z);
+			vec3 hi(c & 4 ? maxPos.x : center.x, c & 2 ? maxPos.y : center.y, c & 1 ? maxPos.z : center.z);
+			children[c] = new SpatialTree(lo, hi, depth + 1, context);
+		}
+		leaf = false;
+		for (const T& e : elements) {
+			insertChildren(e, Bounds::bound(e));
+		}
+		vector<T>().swap(elements);
+		context->splits++;
+	}
+
+	void insertChildren(const T& e, const Bound& bound) {
+		int mask = octantMask(bound, center);
+		for (int c = 0; c < 8; c++) {
+			if (mask & (1 << c)) {
+				children[c]->insert(e, bound);
+			}
+		}
+	}
+
+	void insert(const T& e, const Bound& bound) {
+		numElements++;
+		if (leaf && depth < context->params.maxDepth && numElements > context->params.maxBallsPerOctree) {
+			createChildren();
+		}
+		if (!leaf) {
+			insertChildren(e, bound);
+		}
+		else {
+			addElement(e);
+		}
+	}
+
+	template <typename F>
+	void walkLeafPairs(F& visit) const {
+		if (!leaf) {
+			for (int c = 0; c < 8; c++) {
+				children[c]->walkLeafPairs(visit);
+			}
+			return;
+		}
+		for (size_t i = 0; i < elements.size(); i++) {
+			for (size_t j = i + 1; j < elements.size(); j++) {
+				visit(elements[i], elements[j]);
+			}
+		}
+	}
+
+	template <typename F>
+	void walkSide(int axis, int side, F& visit) const {
+		if (leaf) {
+			for (const T& e : elements) {
+				visit(e);
+			}
+			return;
+		}
+		int bit = 4 >> axis;
+		for (int c = 0; c < 8; c++) {
+			if (((c & bit) != 0) == (side != 0)) {
+				children[c]->walkSide(axis, side, visit);
+			}
+		}
+	}
+
+	template <typename F>
+	void walkFrustum(const Frustum& frustum, float reach, float margin, F& visit, bool inside) const {
+		if (!inside) {
+			FrustumTest test = classifyBox(frustum, minPos, maxPos, reach);
+			if (test == FRUSTUM_OUTSIDE) {
+				return;
+			}
+			inside = test == FRUSTUM_INSIDE;
+		}
+		if (!leaf) {
+			for (int c = 0; c < 8; c++) {
+				children[c]->walkFrustum(frustum, reach, margin, visit, inside);
+			}
+			return;
+		}
+		for (const T& e : elements) {
+			if (inside || boundInFrustum(frustum, Bounds::bound(e), margin)) {
+				visit(e);
+			}
+		}
+	}
+
+	template <typename F>
+	void walkBox(const vec3& lo, const vec3& hi, F& visit) const {
+		if (glm::any(glm::greaterThan(minPos, hi)) || glm::any(glm::greaterThan(lo, maxPos))) {
+			return;
+		}
+		if (!leaf) {
+			for (int c = 0; c < 8; c++) {
+				children[c]->walkBox(lo, hi, visit);
+			}
+			return;
+		}
+		for (const T& e : elements) {
+			if (boundOverlapsBox(Bounds::bound(e), lo, hi)) {
+				visit(e);
+			}
+		}
+	}
+
+	SpatialTree(vec3 minPos, vec3 maxPos, int depth, OctreeContext* context) :
+		minPos(minPos), maxPos(maxPos), center((minPos + maxPos) * 0.5f), numElements(0), depth(depth), leaf(true),
+		children(), context(context), ownsContext(false) {}
+
+public:
+	SpatialTree(vec3 minPos = MIN_POS, vec3 maxPos = MAX_POS, const OctreeParams& params = OctreeParams()) :
+		minPos(minPos), maxPos(maxPos), center((minPos + maxPos) * 0.5f), numElements(0), depth(0), leaf(true),
+		children(), context(new OctreeContext()), ownsContext(true)
+	{
+		context->params = params;
+	}
+
+	SpatialTree(const SpatialTree&) = delete;
+	SpatialTree& operator=(const SpatialTree&) = delete;
+
+	~SpatialTree() {
+		if (!leaf) {
+			destroyChildren();
+		}
+		if (ownsContext) {
+			delete context;
+		}
+	}
+
+	void insert(const T& e) {
+		insert(e, Bounds::bound(e));
+	}
+
+	// remove an element from the leaves it was inserted into with the bound it had then
+	void remove(const T& e, const Bound& oldBound) {
+		numElements--;
+		if (!leaf) {
+			if (numElements < context->params.minBallsPerOctree) {
+				deleteChildren();
+				eraseElement(e);
+			}
+			else {
+				int mask = octantMask(oldBound, center);
+				for (int c = 0; c < 8; c++) {
+					if (mask & (1 << c)) {
+						children[c]->remove(e, oldBound);
+					}
+				}
+			}
+		}
+		else {
+			eraseElement(e);
+		}
+	}
+
+	// move an element whose bound was oldBound
+	void update(const T& e, const Bound& oldBound) {
+		remove(e, oldBound);
+		insert(e);
+	}
+
+	// call visit(a, b) for every two elements sharing a leaf, with a < b, a pair sharing
+	// several leaves is visited once for each of them
+	template <typename F>
+	void visitLeafPairs(F visit) const {
+		walkLeafPairs(visit);
+	}
+
+	// call visit(e) for the elements of every leaf on the lower (side 0) or upper (side 1)
+	// face of the root along axis
+	template <typename F>
+	void visitSide(int axis, int side, F visit) const {
+		walkSide(axis, side, visit);
+	}
+
+	// call visit(e) for the elements that may be inside the frustum, widened by margin
+	// an element reaches at most reach out of its leaves, by which the node bounds are widened,
+	// and a node entirely inside accepts its whole subtree without further tests
+	template <typename F>
+	void visitFrustum(const Frustum& frustum, float reach, float margin, F visit) const {
+		walkFrustum(frustum, reach, margin, visit, false);
+	}
+
+	// call visit(e) for the elements whose bound overlaps the box, an element straddling
+	// several leaves in the box is visited once for each of them
+	template <typename F>
+	void visitBox(const vec3& lo, const vec3& hi, F visit) const {
+		walkBox(lo, hi, visit);
+	}
+
+	const OctreeParams& getParams() const {
+		return context->params;
+	}
+
+	long long getSplits() const {
+		return context->splits;
+	}
+
+	long long getMerges() const {
+		return context->merges;
+	}
+
+	// walk the tree and fill in node counts and histograms
+	void collectStats(OctreeStats& stats) const {
+		stats.numNodes++;
+		stats.nodeMemory += sizeof(SpatialTree) + elements.capacity() * sizeof(T);
+		if (!leaf) {
+			for (int c = 0; c < 8; c++) {
+				children[c]->collectStats(stats);
+			}
+			return;
+		}
+		int count = (int)elements.size();
+		stats.numLeaves++;
+		stats.numBallRefs += count;
+		if ((int)stats.depthHistogram.size() <= depth) {
+			stats.depthHistogram.resize(depth + 1, 0);
+		}
+		stats.depthHistogram[depth]++;
+		if ((int)stats.occupancyHistogram.size() <= count) {
+			stats.occupancyHistogram.resize(count + 1, 0);
+		}
+		stats.occupancyHistogram[count]++;
+	}
+};
+
+#endif
@@ -8,23 +8,35 @@
 #include <vector>
 using namespace std;
 
+// one level of detail inside the shared vertex and index arrays,
+// its indices count from baseVertex
+struct SphereLod {
+	int stacks;
+	int sectors;
+	int baseVertex;
+	int firstIndex;
+	int numIndices;
+};
 
 class Sphere
 {
 public:
 	vector<float> vertices;
 	vector<int> indices;
+	vector<SphereLod> lods;
 
+	// (num_stacks + 1) x (num_sectors + 1) vertices, the first and last column
+	// overlap so the seam has its own vertices
 	void buildSphere(int num_stacks=NUM_STACKS, int num_sectors=NUM_SECTORS)
 	{
-		float sectorStep = 2 * PI / NUM_SECTORS;
-		float stackStep = PI / NUM_STACKS;
+		float sectorStep = 2 * PI / num_sectors;
+		float stackStep = PI / num_stacks;
 
-		for (int i = 0; i < num_stacks; i++) {
+		for (int i = 0; i <= num_stacks; i++) {
 			float stackAngle = PI / 2 - i * stackStep;
 			float xy = cosf(stackAngle);
 			float z = sinf(stackAngle);
-			for (int j = 0; j < num_sectors; j++) {
+			for (int j = 0; j <= num_sectors; j++) {
 				float sectorAngle = j * sectorStep;
 				float x = xy * cosf(sectorAngle);
 				float y = xy * sinf(sectorAngle);
@@ -40,18 +52,19 @@ public:
 		}
 	}
 
-	void generateIndices()
+	// counter-clockwise seen from outside, relative to the first vertex of the sphere
+	void generateIndices(int num_stacks=NUM_STACKS, int num_sectors=NUM_SECTORS)
 	{
-		for (int i = 0; i < NUM_STACKS; i++) {
-			int k1 = i * (NUM_SECTORS + 1);
-			int k2 = k1 + NUM_SECTORS + 1;
-			for (int j = 0; j < NUM_SECTORS; j++, ++k1, ++k2) {
+		for (int i = 0; i < num_stacks; i++) {
+			int k1 = i * (num_sectors + 1);
+			int k2 = k1 + num_sectors + 1;
+			for (int j = 0; j < num_sectors; j++, ++k1, ++k2) {
 				if (i != 0) {
 					indices.push_back(k1);
 					indices.push_back(k2);
 					indices.push_back(k1 + 1);
 				}
-				if (i != NUM_STACKS - 1)
+				if (i != num_stacks - 1)
 				{
 					indices.push_back(k1 + 1);
 					indices.push_back(k2);
@@ -60,6 +73,27 @@ public:
 			}
 		}
 	}
-};
-#endif 
 
+	// append one more level of detail to the arrays
+	void addLod(int num_stacks, int num_sectors)
+	{
+		SphereLod lod;
+		lod.stacks = num_stacks;
+		lod.sectors = num_sectors;
+		lod.baseVertex = (int)vertices.size() / 6;
+		lod.firstIndex = (int)indices.size();
+		buildSphere(num_stacks, num_sectors);
+		generateIndices(num_stacks, num_sectors);
+		lod.numIndices = (int)indices.size() - lod.firstIndex;
+		lods.push_back(lod);
+	}
+
+	// every level of SPHERE_LOD_SECTORS, from the finest
+	void buildLods()
+	{
+		for (int i = 0; i < NUM_SPHERE_LODS; i++) {
+			addLod(SPHERE_LOD_SECTORS[i], SPHERE_LOD_SECTORS[i]);
+		}
+	}
+};
+#endif
@@ -0,0 +1,185 @@
+// a buffer for data written by the cpu every frame and read by the gpu once
+// it is split into three segments used in turn, each guarded by a fence, so the cpu
+// writes one segment while the gpu may still read the other two and neither waits
+// with ARB_buffer_storage the whole buffer stays mapped and the cpu writes straight
+// into gpu-visible memory, otherwise each segment is mapped unsynchronized when written
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+// glad is generated for gl 3.3, buffer storage is core in 4.4
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+const int STREAM_SEGMENTS = 3;
+
+class StreamBuffer {
+private:
+	PFNGLBUFFERSTORAGEPROC_ bufferStorage; // null when not supported
+	unsigned int buffer;
+	size_t segmentSize;
+	int segment; // the one written this frame
+	char* mapped; // the whole buffer when persistent, else the current segment while written
+	GLsync fences[STREAM_SEGMENTS];
+
+	void waitFence(int s) {
+		if (fences[s] == 0) {
+			return;
+		}
+		GLbitfield flags = 0;
+		while (glClientWaitSync(fences[s], flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+			// make sure the fence gets to the gpu before waiting for it again
+			flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		}
+		glDeleteSync(fences[s]);
+		fences[s] = 0;
+	}
+
+	void destroy() {
+		for (int s = 0; s < STREAM_SEGMENTS; s++) {
+			waitFence(s);
+		}
+		if (buffer != 0) {
+			if (mapped != nullptr) {
+				glBindBuffer(GL_ARRAY_BUFFER, buffer);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		mapped = nullptr;
+		segmentSize = 0;
+	}
+
+	void create(size_t size) {
+		segmentSize = size;
+		segment = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (bufferStorage != nullptr) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			bufferStorage(GL_ARRAY_BUFFER, segmentSize * STREAM_SEGMENTS, NULL, flags);
+			mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, segmentSize * STREAM_SEGMENTS, flags);
+		}
+		else {
+			glBufferData(GL_ARRAY_BUFFER, segmentSize * STREAM_SEGMENTS, NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+public:
+	StreamBuffer() : bufferStorage(nullptr), buffer(0), segmentSize(0), segment(0), mapped(nullptr) {
+		for (int s = 0; s < STREAM_SEGMENTS; s++) {
+			fences[s] = 0;
+		}
+	}
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// needs a current context, load is the loader glad was initialised with
+	// returns whether the buffer is persistently mapped
+	bool init(size_t initialSegmentSize, GLADloadproc load, bool allowPersistent=true) {
+		bufferStorage = nullptr;
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		bool supported = major > 4 || (major == 4 && minor >= 4);
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (GLint i = 0; i < numExtensions && !supported; i++) {
+			supported = strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+		}
+		if (supported && allowPersistent && load != nullptr) {
+			bufferStorage = (PFNGLBUFFERSTORAGEPROC_)load("glBufferStorage");
+			if (bufferStorage == nullptr) {
+				bufferStorage = (PFNGLBUFFERSTORAGEPROC_)load("glBufferStorageARB");
+			}
+		}
+		create(std::max(initialSegmentSize, (size_t)1));
+		if (bufferStorage != nullptr && mapped == nullptr) {
+			// mapping failed after all, start over without buffer storage
+			destroy();
+			bufferStorage = nullptr;
+			create(std::max(initialSegmentSize, (size_t)1));
+		}
+		return isPersistent();
+	}
+
+	~StreamBuffer() {
+		release();
+	}
+
+	void release() {
+		destroy();
+	}
+
+	bool isPersistent() const {
+		return bufferStorage != nullptr;
+	}
+
+	unsigned int id() const {
+		return buffer;
+	}
+
+	// byte offset of the segment written this frame
+	size_t offset() const {
+		return (size_t)segment * segmentSize;
+	}
+
+	// memory to write this frame's data into, waits only if the gpu is still reading
+	// the segment from three frames ago
+	// a larger request recreates the buffer, so previously bound offsets are stale
+	char* begin(size_t size) {
+		if (size > segmentSize) {
+			size_t grown = segmentSize;
+			while (grown < size) {
+				grown *= 2;
+			}
+			destroy();
+			create(grown);
+		}
+		waitFence(segment);
+		if (isPersistent()) {
+			return mapped + offset();
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, offset(), segmentSize,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return mapped;
+	}
+
+	// done writing, the segment may be drawn from
+	void end() {
+		if (isPersistent() || mapped == nullptr) {
+			return;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		mapped = nullptr;
+	}
+
+	// after the last draw reading this frame's segment, move on to the next one
+	void fence() {
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		segment = (segment + 1) % STREAM_SEGMENTS;
+	}
+};
+
+#endif
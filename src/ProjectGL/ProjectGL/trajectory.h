@@ -0,0 +1,517 @@
+// compressed recording and replay of ball trajectories
+// positions are quantized to 16 bits per axis over the box, predicted from
+// the previous frames and the residuals are Rice coded in small blocks
+// a keyframe is stored every few frames so the reader can seek
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "global.h"
+#include "octree.h"
+#include "mapped_file.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const char TRAJECTORY_MAGIC[8] = { 'B', 'A', 'L', 'L', 'T', 'R', 'A', 'J' };
+const char TRAJECTORY_INDEX_MAGIC[8] = { 'T', 'R', 'A', 'J', 'I', 'N', 'D', 'X' };
+const uint32_t TRAJECTORY_VERSION = 1;
+const int TRAJECTORY_KEYFRAME_INTERVAL = 32;
+const int TRAJECTORY_QUEUE_SIZE = 8; // frames waiting for the writer before record() blocks
+const int RICE_BLOCK_SIZE = 64; // residuals sharing one Rice parameter
+const int RICE_ESCAPE = 24; // quotients this large are stored raw
+const float QUANT_SCALE = 65535.0f;
+
+struct TrajectoryHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numBalls;
+	uint32_t keyframeInterval;
+	uint32_t reserved;
+	float minPos[3];
+	float maxPos[3];
+	// followed by the radius and colour of every ball, then the frames
+};
+
+struct FrameHeader {
+	uint32_t size; // payload bytes
+	uint32_t keyframe;
+	uint64_t frame;
+};
+
+// written after the last frame so the reader can seek without scanning
+struct TrajectoryFooter {
+	uint64_t indexOffset; // array of keyframe offsets
+	uint64_t numKeyframes;
+	uint64_t numFrames;
+	char magic[8];
+};
+
+inline uint32_t zigzag(int32_t v) {
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t v) {
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+class BitWriter {
+private:
+	vector<uint8_t>& out;
+	uint64_t acc;
+	int bits;
+
+public:
+	BitWriter(vector<uint8_t>& out) : out(out), acc(0), bits(0) {}
+
+	void write(uint32_t value, int n) {
+		if (n > 24) {
+			write(value >> 16, n - 16);
+			write(value & 0xffff, 16);
+			return;
+		}
+		acc |= (uint64_t)(value & ((1u << n) - 1)) << bits;
+		bits += n;
+		while (bits >= 8) {
+			out.push_back((uint8_t)acc);
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+
+	void flush() {
+		if (bits > 0) {
+			out.push_back((uint8_t)acc);
+		}
+		acc = 0;
+		bits = 0;
+	}
+};
+
+class BitReader {
+private:
+	const uint8_t* data;
+	const uint8_t* end;
+	uint64_t acc;
+	int bits;
+
+	void refill() {
+		while (bits <= 56) {
+			uint64_t byte = data < end ? *data++ : 0;
+			acc |= byte << bits;
+			bits += 8;
+		}
+	}
+
+public:
+	BitReader(const uint8_t* data, size_t size) : data(data), end(data + size), acc(0), bits(0) {}
+
+	uint32_t read(int n) {
+		if (n > 24) {
+			uint32_t hi = read(n - 16);
+			return hi << 16 | read(16);
+		}
+		if (bits < n) {
+			refill();
+		}
+		uint32_t value = (uint32_t)(acc & ((1ull << n) - 1));
+		acc >>= n;
+		bits -= n;
+		return value;
+	}
+};
+
+// encode the residuals in blocks, each with the Rice parameter fitting its mean
+void riceEncode(const vector<uint32_t>& values, vector<uint8_t>& out) {
+	BitWriter writer(out);
+	for (size_t first = 0; first < values.size(); first += RICE_BLOCK_SIZE) {
+		size_t last = std::min(first + RICE_BLOCK_SIZE, values.size());
+		uint64_t sum = 0;
+		for (size_t i = first; i < last; i++) {
+			sum += values[i];
+		}
+		int k = 0;
+		while (k < 16 && ((uint64_t)(last - first) << (k + 1)) <= sum) {
+			k++;
+		}
+		writer.write(k, 5);
+		for (size_t i = first; i < last; i++) {
+			uint32_t q = values[i] >> k;
+			if (q >= RICE_ESCAPE) {
+				writer.write((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+				writer.write(values[i], 32);
+				continue;
+			}
+			writer.write((1u << q) - 1, q + 1); // q ones and a zero
+			writer.write(values[i], k);
+		}
+	}
+	writer.flush();
+}
+
+void riceDecode(const uint8_t* data, size_t size, vector<uint32_t>& values) {
+	BitReader reader(data, size);
+	for (size_t first = 0; first < values.size(); first += RICE_BLOCK_SIZE) {
+		size_t last = std::min(first + RICE_BLOCK_SIZE, values.size());
+		int k = reader.read(5);
+		for (size_t i = first; i < last; i++) {
+			uint32_t q = 0;
+			while (q < RICE_ESCAPE && reader.read(1)) {
+				q++;
+			}
+			if (q == RICE_ESCAPE) {
+				values[i] = reader.read(32);
+				continue;
+			}
+			values[i] = q << k | reader.read(k);
+		}
+	}
+}
+
+inline uint16_t quantize(float v, float lo, float hi) {
+	float t = (v - lo) / (hi - lo);
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	return (uint16_t)(t * QUANT_SCALE + 0.5f);
+}
+
+inline float dequantize(uint16_t q, float lo, float hi) {
+	return lo + (hi - lo) * (q / QUANT_SCALE);
+}
+
+// the prediction shared by the writer and the reader:
+// nothing on a keyframe, the previous frame right after it,
+// and the previous frame moved by the last delta afterwards
+inline int32_t predict(int history, uint16_t prev, uint16_t prevPrev) {
+	if (history == 0) {
+		return 0;
+	}
+	if (history == 1) {
+		return prev;
+	}
+	return 2 * (int32_t)prev - (int32_t)prevPrev;
+}
+
+// a quantized frame, three planes of numBalls values
+typedef vector<uint16_t> QuantFrame;
+
+class TrajectoryWriter {
+private:
+	FILE* file;
+	uint64_t written; // bytes, ftell is only 32 bits on windows
+	uint32_t numBalls;
+	uint64_t numFrames;
+	vector<uint64_t> keyframeOffsets;
+	QuantFrame prev, prevPrev;
+	int history;
+
+	thread worker;
+	mutex lock;
+	condition_variable changed;
+	deque<QuantFrame> queue;
+	bool closing;
+	bool failed; // a write came up short, the frames after it are dropped
+
+	void encode(const QuantFrame& frame) {
+		bool keyframe = numFrames % TRAJECTORY_KEYFRAME_INTERVAL == 0;
+		if (keyframe) {
+			history = 0;
+			keyframeOffsets.push_back(written);
+		}
+		vector<uint32_t> residuals(frame.size());
+		for (size_t i = 0; i < frame.size(); i++) {
+			residuals[i] = zigzag((int32_t)frame[i] - predict(history, prev.empty() ? 0 : prev[i], prevPrev.empty() ? 0 : prevPrev[i]));
+		}
+		vector<uint8_t> payload;
+		riceEncode(residuals, payload);
+
+		FrameHeader header;
+		header.size = (uint32_t)payload.size();
+		header.keyframe = keyframe ? 1 : 0;
+		header.frame = numFrames;
+		if (failed || fwrite(&header, sizeof(header), 1, file) != 1 ||
+			fwrite(payload.data(), 1, payload.size(), file) != payload.size()) {
+			failed = true;
+			return;
+		}
+		written += sizeof(header) + payload.size();
+
+		prevPrev.swap(prev);
+		prev = frame;
+		history = std::min(history + 1, 2);
+		numFrames++;
+	}
+
+	void run() {
+		while (true) {
+			QuantFrame frame;
+			{
+				unique_lock<mutex> guard(lock);
+				changed.wait(guard, [this]() { return closing || !queue.empty(); });
+				if (queue.empty()) {
+					return;
+				}
+				frame.swap(queue.front());
+				queue.pop_front();
+			}
+			changed.notify_all();
+			encode(frame);
+		}
+	}
+
+public:
+	TrajectoryWriter() : file(nullptr), written(0), numBalls(0), numFrames(0), history(0), closing(false), failed(false) {}
+
+	~TrajectoryWriter() {
+		close();
+	}
+
+	// start a recording, the radii and colours are stored once as they never change
+	bool open(const char* path, const vector<Ball*>& balls) {
+		close();
+		file = fopen(path, "wb");
+		if (file == nullptr) {
+			cout << "ERROR: TRAJECTORY UNABLE TO WRITE!" << endl;
+			return false;
+		}
+		numBalls = (uint32_t)balls.size();
+		numFrames = 0;
+		history = 0;
+		keyframeOffsets.clear();
+		prev.clear();
+		prevPrev.clear();
+
+		TrajectoryHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+		header.version = TRAJECTORY_VERSION;
+		header.numBalls = numBalls;
+		header.keyframeInterval = TRAJECTORY_KEYFRAME_INTERVAL;
+		for (int c = 0; c < 3; c++) {
+			header.minPos[c] = MIN_POS[c];
+			header.maxPos[c] = MAX_POS[c];
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (auto b : balls) {
+			ok = ok && fwrite(&b->radius, sizeof(float), 1, file) == 1;
+		}
+		for (auto b : balls) {
+			ok = ok && fwrite(&b->color, sizeof(vec3), 1, file) == 1;
+		}
+		if (!ok) {
+			cout << "ERROR: TRAJECTORY UNABLE TO WRITE!" << endl;
+			fclose(file);
+			file = nullptr;
+			return false;
+		}
+		written = sizeof(header) + balls.size() * (sizeof(float) + sizeof(vec3));
+		failed = false;
+
+		closing = false;
+		worker = thread([this]() { run(); });
+		return true;
+	}
+
+	bool isOpen() const {
+		return file != nullptr;
+	}
+
+	// quantize the positions on the calling thread and hand them to the writer,
+	// blocks only if the writer is several frames behind
+	void record(const vector<Ball*>& balls) {
+		if (file == nullptr || balls.size() != numBalls) {
+			return;
+		}
+		QuantFrame frame(3 * (size_t)numBalls);
+		for (uint32_t i = 0; i < numBalls; i++) {
+			for (int c = 0; c < 3; c++) {
+				frame[c * (size_t)numBalls + i] = quantize(balls[i]->pos[c], MIN_POS[c], MAX_POS[c]);
+			}
+		}
+		{
+			unique_lock<mutex> guard(lock);
+			changed.wait(guard, [this]() { return queue.size() < TRAJECTORY_QUEUE_SIZE; });
+			queue.push_back(QuantFrame());
+			queue.back().swap(frame);
+		}
+		changed.notify_all();
+	}
+
+	// drain the queue and write the keyframe index, false if any of the recording was lost
+	bool close() {
+		if (file == nullptr) {
+			return true;
+		}
+		{
+			lock_guard<mutex> guard(lock);
+			closing = true;
+		}
+		changed.notify_all();
+		worker.join();
+
+		TrajectoryFooter footer;
+		footer.indexOffset = written;
+		footer.numKeyframes = keyframeOffsets.size();
+		footer.numFrames = numFrames;
+		memcpy(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic));
+		// a recording that failed part way is left without the index, the reader rebuilds it
+		// from the frames that made it to the disk
+		if (!failed) {
+			failed = fwrite(keyframeOffsets.data(), sizeof(uint64_t), keyframeOffsets.size(), file) != keyframeOffsets.size() ||
+				fwrite(&footer, sizeof(footer), 1, file) != 1;
+		}
+		failed = fclose(file) != 0 || failed;
+		file = nullptr;
+		if (failed) {
+			cout << "ERROR: TRAJECTORY WRITE FAILED, THE RECORDING IS TRUNCATED!" << endl;
+		}
+		return !failed;
+	}
+};
+
+class TrajectoryReader {
+private:
+	MappedFile file;
+	const TrajectoryHeader* header;
+	uint64_t firstFrameOffset;
+	vector<uint64_t> keyframeOffsets;
+	uint64_t numFrames;
+
+	uint64_t cursor; // offset of the next frame to decode
+	uint64_t nextFrame;
+	QuantFrame prev, prevPrev;
+	int history;
+
+	// frames are not aligned in the file so their headers are copied out
+	bool frameAt(uint64_t offset, FrameHeader& frame) const {
+		if (offset + sizeof(FrameHeader) > file.size()) {
+			return false;
+		}
+		memcpy(&frame, file.begin() + offset, sizeof(frame));
+		return offset + sizeof(FrameHeader) + frame.size <= file.size();
+	}
+
+	// rebuild the index of a recording that was not closed
+	void scanFrames() {
+		keyframeOffsets.clear();
+		numFrames = 0;
+		uint64_t offset = firstFrameOffset;
+		FrameHeader frame;
+		while (frameAt(offset, frame) && frame.frame == numFrames) {
+			if (frame.keyframe) {
+				keyframeOffsets.push_back(offset);
+			}
+			offset += sizeof(FrameHeader) + frame.size;
+			numFrames++;
+		}
+	}
+
+public:
+	TrajectoryReader() : header(nullptr), firstFrameOffset(0), numFrames(0), cursor(0), nextFrame(0), history(0) {}
+
+	bool open(const char* path) {
+		header = nullptr;
+		if (!file.open(path) || file.size() < sizeof(TrajectoryHeader)) {
+			cout << "ERROR: TRAJECTORY UNABLE TO LOAD!" << endl;
+			return false;
+		}
+		const TrajectoryHeader* h = (const TrajectoryHeader*)file.begin();
+		firstFrameOffset = sizeof(TrajectoryHeader) + (uint64_t)h->numBalls * (sizeof(float) + sizeof(vec3));
+		if (memcmp(h->magic, TRAJECTORY_MAGIC, sizeof(h->magic)) != 0 || h->version != TRAJECTORY_VERSION ||
+			firstFrameOffset > file.size()) {
+			cout << "ERROR: TRAJECTORY IS CORRUPT OR OF ANOTHER VERSION!" << endl;
+			file.close();
+			return false;
+		}
+		header = h;
+
+		TrajectoryFooter footer;
+		memset(&footer, 0, sizeof(footer));
+		if (file.size() >= firstFrameOffset + sizeof(TrajectoryFooter)) {
+			memcpy(&footer, file.end() - sizeof(footer), sizeof(footer));
+		}
+		if (memcmp(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic)) == 0 &&
+			footer.indexOffset + footer.numKeyframes * sizeof(uint64_t) + sizeof(TrajectoryFooter) == file.size()) {
+			keyframeOffsets.resize((size_t)footer.numKeyframes);
+			memcpy(keyframeOffsets.data(), file.begin() + footer.indexOffset, keyframeOffsets.size() * sizeof(uint64_t));
+			numFrames = footer.numFrames;
+		}
+		else {
+			scanFrames();
+		}
+		return seek(0);
+	}
+
+	uint32_t numBalls() const { return header->numBalls; }
+	uint64_t frameCount() const { return numFrames; }
+	uint64_t currentFrame() const { return nextFrame; }
+
+	const float* radii() const {
+		return (const float*)(file.begin() + sizeof(TrajectoryHeader));
+	}
+
+	const vec3* colors() const {
+		return (const vec3*)(file.begin() + sizeof(TrajectoryHeader) + header->numBalls * sizeof(float));
+	}
+
+	// position the reader so next() returns the given frame,
+	// decoding forward from the closest keyframe before it
+	bool seek(uint64_t frame) {
+		if (header == nullptr || keyframeOffsets.empty() || frame >= numFrames) {
+			return false;
+		}
+		uint64_t key = std::min(frame / header->keyframeInterval, (uint64_t)keyframeOffsets.size() - 1);
+		cursor = keyframeOffsets[key];
+		nextFrame = key * header->keyframeInterval;
+		history = 0;
+		vector<vec3> skipped;
+		while (nextFrame < frame) {
+			if (!next(skipped)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// decode the next frame into positions, false at the end of the recording
+	bool next(vector<vec3>& positions) {
+		FrameHeader frame;
+		if (header == nullptr || !frameAt(cursor, frame) || frame.frame != nextFrame) {
+			return false;
+		}
+		if (frame.keyframe) {
+			history = 0;
+		}
+		size_t n = header->numBalls;
+		vector<uint32_t> residuals(3 * n);
+		riceDecode((const uint8_t*)file.begin() + cursor + sizeof(FrameHeader), frame.size, residuals);
+		QuantFrame current(3 * n);
+		for (size_t i = 0; i < current.size(); i++) {
+			current[i] = (uint16_t)(unzigzag(residuals[i]) + predict(history, prev.empty() ? 0 : prev[i], prevPrev.empty() ? 0 : prevPrev[i]));
+		}
+		positions.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			for (int c = 0; c < 3; c++) {
+				positions[i][c] = dequantize(current[c * n + i], header->minPos[c], header->maxPos[c]);
+			}
+		}
+		prevPrev.swap(prev);
+		prev.swap(current);
+		history = std::min(history + 1, 2);
+		cursor += sizeof(FrameHeader) + frame.size;
+		nextFrame++;
+		return true;
+	}
+};
+
+#endif
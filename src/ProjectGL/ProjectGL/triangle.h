@@ -0,0 +1,186 @@
+// geometric tests on single triangles
+// reference: Christer Ericson, "Real-Time Collision Detection", 2005, section 5.1.5
+// Tomas Moller, "A Fast Triangle-Triangle Intersection Test", 1997
+
+#ifndef TRIANGLE_H
+#define TRIANGLE_H
+
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+const float TRIANGLE_EPSILON = 1e-6f; // relative to the size of a triangle, distances below are 0
+
+// the point of triangle abc closest to p, found from the voronoi region p lies in
+inline vec3 closestPointOnTriangle(const vec3& p, const vec3& a, const vec3& b, const vec3& c) {
+	vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		return a;
+	}
+	vec3 bp = p - b;
+	float d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		return b;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return a + ab * (d1 / (d1 - d3));
+	}
+	vec3 cp = p - c;
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		return c;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return a + ac * (d2 / (d2 - d6));
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+	// inside the face
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// the solid angle triangle abc covers seen from p, positive when p is behind it, on the side
+// its normal cross(b - a, c - a) points away from
+// reference: A. Van Oosterom and J. Strackee, "The Solid Angle of a Plane Triangle", 1983
+inline float triangleSolidAngle(const vec3& p, const vec3& a, const vec3& b, const vec3& c) {
+	vec3 u = a - p, v = b - p, w = c - p;
+	float lu = length(u), lv = length(v), lw = length(w);
+	float numerator = dot(u, cross(v, w));
+	float denominator = lu * lv * lw + dot(u, v) * lw + dot(v, w) * lu + dot(w, u) * lv;
+	return 2.0f * atan2f(numerator, denominator);
+}
+
+// squared distance from p to the box [minPos, maxPos], 0 inside
+inline float boxDistanceSquared(const vec3& p, const vec3& minPos, const vec3& maxPos) {
+	vec3 d = glm::max(glm::max(minPos - p, p - maxPos), vec3(0.0f));
+	return dot(d, d);
+}
+
+// the distances of the corners of one triangle to the plane n.x + c = 0 of the other, with
+// the ones too small to trust set to 0, false if all of them are on the same side
+inline bool planeDistances(const vec3& n, float c, float eps, const vec3& a, const vec3& b, const vec3& d, float dist[3]) {
+	dist[0] = dot(n, a) + c;
+	dist[1] = dot(n, b) + c;
+	dist[2] = dot(n, d) + c;
+	for (int i = 0; i < 3; i++) {
+		if (fabsf(dist[i]) < eps) {
+			dist[i] = 0.0f;
+		}
+	}
+	return !((dist[0] > 0.0f && dist[1] > 0.0f && dist[2] > 0.0f) || (dist[0] < 0.0f && dist[1] < 0.0f && dist[2] < 0.0f));
+}
+
+// the interval a triangle covers on the line where the two planes meet, from the projections
+// of its corners on the line and their distances to the other plane, false if it lies in the plane
+inline bool crossingInterval(const float p[3], const float d[3], float& t0, float& t1) {
+	// the corner alone on its side of the plane
+	int k;
+	if (d[0] * d[1] > 0.0f) k = 2;
+	else if (d[0] * d[2] > 0.0f) k = 1;
+	else if (d[1] * d[2] > 0.0f || d[0] != 0.0f) k = 0;
+	else if (d[1] != 0.0f) k = 1;
+	else if (d[2] != 0.0f) k = 2;
+	else return false;
+	int i = (k + 1) % 3, j = (k + 2) % 3;
+	t0 = p[i] + (p[k] - p[i]) * d[i] / (d[i] - d[k]);
+	t1 = p[j] + (p[k] - p[j]) * d[j] / (d[j] - d[k]);
+	if (t0 > t1) {
+		std::swap(t0, t1);
+	}
+	return true;
+}
+
+// whether the 2d segments ab and cd cross
+inline bool segmentsIntersect2D(const vec2& a, const vec2& b, const vec2& c, const vec2& d) {
+	auto side = [](const vec2& o, const vec2& u, const vec2& v) { return (u.x - o.x) * (v.y - o.y) - (u.y - o.y) * (v.x - o.x); };
+	float d1 = side(c, d, a), d2 = side(c, d, b), d3 = side(a, b, c), d4 = side(a, b, d);
+	if (((d1 > 0.0f && d2 < 0.0f) || (d1 < 0.0f && d2 > 0.0f)) && ((d3 > 0.0f && d4 < 0.0f) || (d3 < 0.0f && d4 > 0.0f))) {
+		return true;
+	}
+	// touching ends
+	auto onSegment = [](const vec2& o, const vec2& u, const vec2& p) {
+		return std::min(o.x, u.x) <= p.x && p.x <= std::max(o.x, u.x) && std::min(o.y, u.y) <= p.y && p.y <= std::max(o.y, u.y);
+	};
+	return (d1 == 0.0f && onSegment(c, d, a)) || (d2 == 0.0f && onSegment(c, d, b)) ||
+		(d3 == 0.0f && onSegment(a, b, c)) || (d4 == 0.0f && onSegment(a, b, d));
+}
+
+// whether the 2d point p lies in the triangle abc, of either winding
+inline bool pointInTriangle2D(const vec2& p, const vec2& a, const vec2& b, const vec2& c) {
+	float d1 = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	float d2 = (c.x - b.x) * (p.y - b.y) - (c.y - b.y) * (p.x - b.x);
+	float d3 = (a.x - c.x) * (p.y - c.y) - (a.y - c.y) * (p.x - c.x);
+	return (d1 >= 0.0f && d2 >= 0.0f && d3 >= 0.0f) || (d1 <= 0.0f && d2 <= 0.0f && d3 <= 0.0f);
+}
+
+// two triangles in the plane with normal n, dropped onto the two axes where n is smallest
+inline bool coplanarTrianglesIntersect(const vec3& n, const vec3 p[3], const vec3 q[3]) {
+	vec3 an = abs(n);
+	int drop = an.x > an.y ? (an.x > an.z ? 0 : 2) : (an.y > an.z ? 1 : 2);
+	int u = drop == 0 ? 1 : 0, v = drop == 2 ? 1 : 2;
+	vec2 a[3], b[3];
+	for (int i = 0; i < 3; i++) {
+		a[i] = vec2(p[i][u], p[i][v]);
+		b[i] = vec2(q[i][u], q[i][v]);
+	}
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			if (segmentsIntersect2D(a[i], a[(i + 1) % 3], b[j], b[(j + 1) % 3])) {
+				return true;
+			}
+		}
+	}
+	// one inside the other
+	return pointInTriangle2D(a[0], b[0], b[1], b[2]) || pointInTriangle2D(b[0], a[0], a[1], a[2]);
+}
+
+// the plane of triangle abc as n.x + c = 0 with n of unit length, and the distance below which
+// a point counts as lying in it, false if the triangle is degenerate
+inline bool trianglePlane(const vec3& a, const vec3& b, const vec3& c, vec3& n, float& offset, float& eps) {
+	vec3 e1 = b - a, e2 = c - a;
+	n = cross(e1, e2);
+	float len = length(n);
+	if (!(len > 0.0f)) {
+		return false;
+	}
+	n /= len;
+	offset = -dot(n, a);
+	eps = TRIANGLE_EPSILON * sqrtf(std::max(dot(e1, e1), std::max(dot(e2, e2), dot(c - b, c - b))));
+	return true;
+}
+
+// whether triangles p and q share a point, the interval overlap test of Moller
+inline bool trianglesIntersect(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& q0, const vec3& q1, const vec3& q2) {
+	vec3 n1, n2;
+	float c1, c2, eps1, eps2;
+	if (!trianglePlane(p0, p1, p2, n1, c1, eps1) || !trianglePlane(q0, q1, q2, n2, c2, eps2)) {
+		return false;
+	}
+	float dq[3], dp[3];
+	if (!planeDistances(n1, c1, eps1, q0, q1, q2, dq) || !planeDistances(n2, c2, eps2, p0, p1, p2, dp)) {
+		return false;
+	}
+	vec3 p[3] = { p0, p1, p2 }, q[3] = { q0, q1, q2 };
+	if (dq[0] == 0.0f && dq[1] == 0.0f && dq[2] == 0.0f) {
+		return coplanarTrianglesIntersect(n1, p, q);
+	}
+	// project onto the largest axis of the line where the planes meet
+	vec3 line = abs(cross(n1, n2));
+	int axis = line.x > line.y ? (line.x > line.z ? 0 : 2) : (line.y > line.z ? 1 : 2);
+	float pp[3] = { p0[axis], p1[axis], p2[axis] }, pq[3] = { q0[axis], q1[axis], q2[axis] };
+	float a0, a1, b0, b1;
+	if (!crossingInterval(pp, dp, a0, a1) || !crossingInterval(pq, dq, b0, b1)) {
+		return coplanarTrianglesIntersect(n1, p, q);
+	}
+	return a0 <= b1 && b0 <= a1;
+}
+
+#endif
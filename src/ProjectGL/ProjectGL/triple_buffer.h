@@ -0,0 +1,57 @@
+// a lock-free triple buffer to hand data from one producer thread to one consumer thread
+// the producer always has a buffer to write, the consumer always has a complete
+// buffer to read, and neither ever waits for the other
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+private:
+	// the index of the buffer in the middle, with a flag set when it holds
+	// data the consumer has not seen yet
+	static const int FRESH = 4;
+
+	T buffers[3];
+	std::atomic<int> middle;
+	int back; // owned by the producer
+	int front; // owned by the consumer
+
+public:
+	TripleBuffer() : middle(1), back(0), front(2) {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// producer side: the buffer to fill, it keeps its previous contents
+	// so it can be updated in place
+	T& writeBuffer() {
+		return buffers[back];
+	}
+
+	// producer side: make the filled buffer the latest one
+	void publish() {
+		int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+		back = old & ~FRESH;
+	}
+
+	// consumer side: switch to the latest published buffer if there is one,
+	// return whether the read buffer changed
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+			return false;
+		}
+		int old = middle.exchange(front, std::memory_order_acq_rel);
+		front = old & ~FRESH;
+		return true;
+	}
+
+	// consumer side: the latest buffer, stable until the next update()
+	const T& readBuffer() const {
+		return buffers[front];
+	}
+};
+
+#endif
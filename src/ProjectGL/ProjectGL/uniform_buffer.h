@@ -0,0 +1,70 @@
+// uniforms shared by every program, kept in uniform buffer objects
+// a block is written once per frame and every program that binds it to the same
+// binding point reads it, instead of each program getting its own copies
+// the structs follow the std140 layout of the blocks in resources/shader, so vec3
+// members are padded to vec4
+
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+using namespace glm;
+
+// uniform Camera
+struct CameraBlock {
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos; // xyz
+};
+
+// uniform Light
+struct LightBlock {
+	vec4 direction; // xyz
+	vec4 ambient; // xyz
+	vec4 diffuse; // xyz
+	vec4 specular; // xyz
+};
+
+template <typename T>
+class UniformBuffer {
+private:
+	unsigned int buffer;
+	GLuint binding;
+
+public:
+	UniformBuffer() : buffer(0), binding(0) {}
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	~UniformBuffer() {
+		release();
+	}
+
+	// needs a current context, blockBinding is one of UniformBlockBinding in shader.h
+	void init(GLuint blockBinding) {
+		binding = blockBinding;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+
+	void update(const T& value) {
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void release() {
+		if (buffer != 0) {
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+	}
+};
+
+#endif